@@ -0,0 +1,487 @@
+/**
+* \file KISDbench.cpp
+* \brief Benchmarks of the attention pipeline, driven by the synthetic tracking source.
+*
+* Build it with the application sources (except KITVmain.cpp and FubiTrackingSource.cpp).
+* Results are written on stdout as JSON, always with the same fields in the same order,
+* so that the outputs of two builds can be compared. Progress goes to stderr.
+*
+* Options:
+*	-time seconds	minimum measuring time of each benchmark (default 0.5)
+*	-filter text	only run the benchmarks whose name contains text
+*/
+
+#include "SyntheticTrackingSource.h"
+#include "UserManager.h"
+#include "OSCSender.h"
+#include "OSCReceiver.h"
+#include "WindowManager.h"
+#include "screen.h"
+#include "commandParser.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// every allocation of the process is counted
+static std::atomic<unsigned long long> g_allocations(0);
+
+void* operator new(size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) throw()
+{
+	free(p);
+}
+
+
+struct BenchResult
+{
+	std::string name;
+	int users;
+	int screens;
+	unsigned long long iterations;
+	double nsPerOp;
+	double allocsPerOp;
+	bool isFrame;	// one op is a whole frame, report frames/s
+};
+
+static double g_minTime = 0.5;
+static std::string g_filter;
+static std::vector<BenchResult> g_results;
+
+static const int USER_COUNTS[] = { 1, 2, 6, Fubi::MaxUsers };
+static const int SCREEN_COUNTS[] = { 1, 4, 16, 64 };
+static const int NB_USER_COUNTS = sizeof(USER_COUNTS) / sizeof(USER_COUNTS[0]);
+static const int NB_SCREEN_COUNTS = sizeof(SCREEN_COUNTS) / sizeof(SCREEN_COUNTS[0]);
+static const unsigned int SEED = 42;
+
+// results are stored here so that the compiler cannot drop the computations
+static volatile float g_sink;
+
+
+static bool selected(const std::string& name)
+{
+	return g_filter.empty() || name.find(g_filter) != std::string::npos;
+}
+
+/**
+* \brief Run op in batches of growing size until g_minTime is reached
+*/
+template<typename Op>
+static void runBenchmark(const std::string& name, int users, int screens, bool isFrame, Op op)
+{
+	// warm up: lazy allocations, caches
+	for (int i = 0; i < 100; i++)
+		op();
+
+	typedef std::chrono::steady_clock Clock;
+	unsigned long long iterations = 0;
+	unsigned long long batch = 1;
+	unsigned long long allocations = g_allocations.load();
+	Clock::time_point start = Clock::now();
+	double elapsed = 0;
+	while (elapsed < g_minTime)
+	{
+		for (unsigned long long i = 0; i < batch; i++)
+			op();
+		iterations += batch;
+		batch *= 2;
+		elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	}
+	allocations = g_allocations.load() - allocations;
+
+	BenchResult result;
+	result.name = name;
+	result.users = users;
+	result.screens = screens;
+	result.iterations = iterations;
+	result.nsPerOp = elapsed * 1e9 / iterations;
+	result.allocsPerOp = (double)allocations / iterations;
+	result.isFrame = isFrame;
+	g_results.push_back(result);
+
+	std::cerr << name << " users=" << users << " screens=" << screens << ": " << result.nsPerOp << " ns/op, "
+		<< result.allocsPerOp << " allocs/op" << std::endl;
+}
+
+
+// screens tiled on the wall above the sensor, 3.2m x 1.8m
+static KITV::ScreenManager* createScreenWall(int nbScreens)
+{
+	KITV::ScreenManager* screens = new KITV::ScreenManager();
+	int columns = (int)std::ceil(std::sqrt((double)nbScreens));
+	int rows = (nbScreens + columns - 1) / columns;
+	float width = 3.2f / columns;
+	float height = 1.8f / rows;
+	for (int i = 0; i < nbScreens; i++)
+	{
+		float x = -1.6f + (i % columns + 0.5f) * width;
+		float y = (i / columns + 0.5f) * height;
+		// centery is given from the camera point of view (screen above the camera: negative)
+		screens->addScreen(i + 1, width * 0.9f, height * 0.9f, 1920, 1080, x, -y, 0.0f);
+	}
+	return screens;
+}
+
+
+// head poses of the synthetic users
+static void createHeads(unsigned int count, std::vector<Fubi::Vec3f>& centers, std::vector<Fubi::Vec3f>& rotations)
+{
+	SyntheticTrackingSource source(6, SEED, false);
+	source.init();
+	while (centers.size() < count)
+	{
+		source.update();
+		std::deque<unsigned int> ids = source.getClosestUserIDs();
+		for (unsigned int i = 0; i < ids.size() && centers.size() < count; i++)
+		{
+			centers.push_back(source.getUserHeadCenter(ids[i]));
+			rotations.push_back(source.getUserHeadRotation(ids[i]));
+		}
+	}
+}
+
+
+static void benchScreens()
+{
+	std::vector<Fubi::Vec3f> centers, rotations;
+	createHeads(1024, centers, rotations);
+
+	if (selected("GazeRay::fromHead"))
+	{
+		unsigned int i = 0;
+		runBenchmark("GazeRay::fromHead", 1, 0, false, [&]()
+		{
+			g_sink = GazeRay::fromHead(centers[i], rotations[i]).direction.z;
+			i = (i + 1) % centers.size();
+		});
+	}
+
+	const char* name = "ScreenManager::whichScreen";
+	if (!selected(name))
+		return;
+
+	std::vector<GazeRay> gazes;
+	for (unsigned int i = 0; i < centers.size(); i++)
+		gazes.push_back(GazeRay::fromHead(centers[i], rotations[i]));
+
+	// up to the large video walls
+	static const int WALL_COUNTS[] = { 1, 4, 16, 64, 256, 1024 };
+	for (int s = 0; s < (int)(sizeof(WALL_COUNTS) / sizeof(WALL_COUNTS[0])); s++)
+	{
+		KITV::ScreenManager* screens = createScreenWall(WALL_COUNTS[s]);
+		unsigned int i = 0;
+		runBenchmark("ScreenManager::whichScreenBeingWatched", 1, WALL_COUNTS[s], false, [&]()
+		{
+			g_sink = (float)screens->whichScreenBeingWatched(gazes[i]).id;
+			i = (i + 1) % gazes.size();
+		});
+
+		// all the users of a frame at once
+		KITV::ScreenHit hits[Fubi::MaxUsers];
+		i = 0;
+		runBenchmark("ScreenManager::whichScreensBeingWatched", Fubi::MaxUsers, WALL_COUNTS[s], false, [&]()
+		{
+			screens->whichScreensBeingWatched(&gazes[i], Fubi::MaxUsers, hits);
+			g_sink = (float)hits[0].id;
+			i = (i + Fubi::MaxUsers) % (gazes.size() - Fubi::MaxUsers);
+		});
+		delete screens;
+	}
+}
+
+
+static void benchUserManager()
+{
+	cv::Mat noImage;
+	for (int s = 0; s < NB_SCREEN_COUNTS; s++)
+	{
+		SyntheticTrackingSource source(6, SEED, false);
+		source.init();
+		source.update();
+		UserManager manager(source, false, 640, 480, createScreenWall(SCREEN_COUNTS[s]));
+		manager.update(noImage);
+
+		if (selected("UserManager::userWatchingScreen"))
+		{
+			unsigned int id = 0;
+			runBenchmark("UserManager::userWatchingScreen", 1, SCREEN_COUNTS[s], false, [&]()
+			{
+				g_sink = (float)manager.userWatchingScreen(id + 1).first;
+				id = (id + 1) % 6;
+			});
+		}
+	}
+
+	for (int u = 0; u < NB_USER_COUNTS; u++)
+	{
+		SyntheticTrackingSource source(USER_COUNTS[u], SEED, false);
+		source.init();
+		source.update();
+		UserManager manager(source, false, 640, 480, createScreenWall(1));
+		// fill the face tracked filters
+		for (int i = 0; i < 10; i++)
+		{
+			source.update();
+			manager.update(noImage);
+		}
+
+		if (selected("UserManager::getHeadRotationConfidence"))
+		{
+			// distances of the heads met by the synthetic crowd
+			std::vector<Fubi::Vec3f> centers, rotations;
+			createHeads(1024, centers, rotations);
+			std::vector<float> distances;
+			for (unsigned int i = 0; i < centers.size(); i++)
+				distances.push_back(centers[i].length());
+			unsigned int i = 0;
+			runBenchmark("UserManager::getHeadRotationConfidence", USER_COUNTS[u], 1, false, [&]()
+			{
+				g_sink = manager.getHeadRotationConfidence(distances[i]);
+				i = (i + 1) % distances.size();
+			});
+		}
+		if (selected("UserManager::updateFaceTrackedUsers"))
+		{
+			runBenchmark("UserManager::updateFaceTrackedUsers", USER_COUNTS[u], 1, false, [&]()
+			{
+				manager.updateFaceTrackedUsers();
+			});
+		}
+		if (selected("UserManager::getAttention"))
+		{
+			// what a display or metrics thread pays for a consistent frame
+			AttentionState attention;
+			runBenchmark("UserManager::getAttention", USER_COUNTS[u], 1, false, [&]()
+			{
+				manager.getAttention(attention);
+				g_sink = (float)attention.nbUsers;
+			});
+		}
+	}
+}
+
+
+static void benchOSC()
+{
+	// a typical frame: users count, attention changes and gaze coordinates
+	std::vector<OSCMessage> frame;
+	OSCMessage message;
+	message.text = "/context/nbusers";
+	message.values.push_back(3);
+	frame.push_back(message);
+	for (int i = 1; i <= 3; i++)
+	{
+		message.text = "/context/user/attention";
+		message.values.clear();
+		message.values.push_back((float)i);
+		message.values.push_back(2);
+		message.values.push_back(1);
+		frame.push_back(message);
+		message.text = "/context/user/coordinates";
+		message.values.push_back(512.0f);
+		frame.push_back(message);
+	}
+
+	if (selected("OSCSender::send"))
+	{
+		// nobody listens on this port, the packets are simply lost
+		OSCSender sender;
+		sender.init(std::vector<std::pair<std::string, int> >(1, std::pair<std::string, int>("127.0.0.1", 57999)), false);
+		unsigned int i = 0;
+		sender.beginFrame();
+		runBenchmark("OSCSender::send", 0, 0, false, [&]()
+		{
+			sender.send(frame[i], false);
+			if (++i == frame.size())
+			{
+				sender.endFrame(false);
+				sender.beginFrame();
+				i = 0;
+			}
+		});
+		sender.endFrame(false);
+		sender.close(false);
+	}
+
+	if (selected("OSCSender::sendEvent"))
+	{
+		// the same frame as UserManager events, as sent by the emission stage
+		std::vector<UserEvent> events(frame.size());
+		events[0].type = UserEvent::NB_USERS;
+		events[0].value = 3;
+		for (int i = 1; i <= 3; i++)
+		{
+			UserEvent& attention = events[2 * i - 1];
+			attention.type = UserEvent::ATTENTION;
+			attention.userID = i;
+			attention.screen = 2;
+			attention.value = 1;
+			UserEvent& coordinates = events[2 * i];
+			coordinates.type = UserEvent::COORDINATES;
+			coordinates.userID = i;
+			coordinates.screen = 2;
+			coordinates.x = 1.0f;
+			coordinates.y = 512.0f;
+		}
+
+		OSCSender sender;
+		sender.init(std::vector<std::pair<std::string, int> >(1, std::pair<std::string, int>("127.0.0.1", 57999)), false);
+		std::string address;
+		float values[UserEvent::MAX_OSC_VALUES];
+		unsigned int i = 0;
+		sender.beginFrame();
+		runBenchmark("OSCSender::sendEvent", 0, 0, false, [&]()
+		{
+			unsigned int nbValues = events[i].toOSC(address, values);
+			sender.send(address, values, nbValues, false);
+			if (++i == events.size())
+			{
+				sender.endFrame(false);
+				sender.beginFrame();
+				i = 0;
+			}
+		});
+		sender.endFrame(false);
+		sender.close(false);
+	}
+
+	if (selected("OSCReceiver::parsePacket"))
+	{
+		oscpkt::PacketWriter writer;
+		oscpkt::Message oscMessage;
+		writer.startBundle();
+		for (unsigned int i = 0; i < frame.size(); i++)
+		{
+			oscMessage.init(frame[i].text);
+			for (unsigned int j = 0; j < frame[i].values.size(); j++)
+				oscMessage.pushFloat(frame[i].values[j]);
+			writer.addMessage(oscMessage);
+		}
+		writer.endBundle();
+		std::vector<char> packet(writer.packetData(), writer.packetData() + writer.packetSize());
+
+		std::vector<OSCMessage> parsed;
+		runBenchmark("OSCReceiver::parsePacket", 0, 0, false, [&]()
+		{
+			parsed.clear();
+			OSCReceiver::parsePacket(&packet[0], packet.size(), parsed);
+		});
+	}
+}
+
+
+static void benchFrames()
+{
+	if (!selected("UserManager::update"))
+		return;
+
+	cv::Mat noImage;
+	for (int u = 0; u < NB_USER_COUNTS; u++)
+	{
+		for (int s = 0; s < NB_SCREEN_COUNTS; s++)
+		{
+			SyntheticTrackingSource source(USER_COUNTS[u], SEED, false);
+			source.init();
+			UserManager manager(source, false, 640, 480, createScreenWall(SCREEN_COUNTS[s]));
+			runBenchmark("UserManager::update", USER_COUNTS[u], SCREEN_COUNTS[s], true, [&]()
+			{
+				source.update();
+				manager.update(noImage);
+			});
+		}
+	}
+
+	// crowd in display mode (face crops and annotations), without and with a compute budget of 4 users
+	cv::Mat rgb(480, 640, CV_8UC3, cv::Scalar(0, 0, 0));
+	for (unsigned int budget = 0; budget <= 4; budget += 4)
+	{
+		SyntheticTrackingSource source(Fubi::MaxUsers, SEED, false);
+		source.init();
+		UserManager manager(source, true, 640, 480, createScreenWall(16));
+		if (budget > 0)
+			manager.setBudget(budget);
+		runBenchmark(budget > 0 ? "UserManager::update(display, budget 4)" : "UserManager::update(display)", Fubi::MaxUsers, 16, true, [&]()
+		{
+			source.update();
+			manager.update(rgb);
+		});
+	}
+}
+
+
+static void benchDisplay()
+{
+	if (!selected("WindowManager::show"))
+		return;
+
+	// a crowd in the mosaic, 4 new faces per frame as with a compute budget of 4 users
+	WindowManager windows;
+	windows.init(640, 480);
+	cv::Mat rgb(480, 640, CV_8UC3, cv::Scalar(0, 0, 0));
+	std::vector<cv::Mat> faces;
+	for (unsigned int i = 0; i < Fubi::MaxUsers; i++)
+		faces.push_back(cv::Mat(396, 240, CV_8UC3, cv::Scalar(i * 16, 0, 0)));
+	for (unsigned int i = 0; i < Fubi::MaxUsers; i++)
+		windows.setFace(i + 1, faces[i]);
+	unsigned int next = 0;
+	runBenchmark("WindowManager::show", Fubi::MaxUsers, 0, true, [&]()
+	{
+		rgb.copyTo(windows.getMainView());
+		for (unsigned int i = 0; i < 4; i++, next = (next + 1) % Fubi::MaxUsers)
+			windows.setFace(next + 1, faces[next]);
+		windows.show();
+	});
+}
+
+
+static void printResults()
+{
+	printf("{\n");
+	printf("  \"benchmark\": \"KISDbench\",\n");
+	printf("  \"version\": 1,\n");
+	printf("  \"min_time_s\": %.3f,\n", g_minTime);
+	printf("  \"results\": [\n");
+	for (unsigned int i = 0; i < g_results.size(); i++)
+	{
+		const BenchResult& r = g_results[i];
+		printf("    {\"name\": \"%s\", \"users\": %d, \"screens\": %d, \"iterations\": %llu, "
+			"\"ns_per_op\": %.2f, \"allocs_per_op\": %.3f, \"fps\": ",
+			r.name.c_str(), r.users, r.screens, r.iterations, r.nsPerOp, r.allocsPerOp);
+		if (r.isFrame)
+			printf("%.1f", 1e9 / r.nsPerOp);
+		else
+			printf("null");
+		printf("}%s\n", (i + 1 < g_results.size()) ? "," : "");
+	}
+	printf("  ]\n");
+	printf("}\n");
+}
+
+
+int main(int argc, char ** argv)
+{
+	std::string value;
+	if (CommandParser::parse_argument(argc, argv, "-time", value) > 0)
+		g_minTime = atof(value.c_str());
+	CommandParser::parse_argument(argc, argv, "-filter", g_filter);
+
+	benchScreens();
+	benchUserManager();
+	benchOSC();
+	benchFrames();
+	benchDisplay();
+
+	printResults();
+	return 0;
+}
@@ -15,7 +15,7 @@
 */ 
 
 #include "FubiMath.h"
-#include <opencv2\opencv.hpp>
+#include <opencv2/opencv.hpp>
 
 #include <map>
 #include <deque>
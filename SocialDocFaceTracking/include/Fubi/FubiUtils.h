@@ -17,6 +17,7 @@
 #include <time.h>
 #include <string>
 #include <sstream>
+#include <cmath>
 
 
 namespace Fubi
@@ -880,7 +881,7 @@ namespace Fubi
                     else
                         direction = "backward";
                 }
-                if (std::fabsf(value) > 0.01f)
+                if (std::fabs(value) > 0.01f)
                 {
                     std::string mod = "";
 					if (hint.m_changeType == RecognitionCorrectionHint::LENGTH)
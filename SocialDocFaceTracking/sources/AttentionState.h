@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Fubi/FubiUtils.h>
+
+#include <stdint.h>
+
+// attention of one user, as published after a frame
+struct UserAttention
+{
+	unsigned int id;
+	bool isFaceTracked;
+	int screenWatched;			// id of the screen, 0 if none
+	int interest;				// TrackedUser::Interest
+	float interestTime;			// time spent watching the screen (s)
+	float headConfidence;		// [0..1], 0 if the head rotation is not trusted
+	float headDistance;			// from the sensor (mm), 0 if the face is not tracked
+};
+
+/**
+* \brief Attention of the whole scene after one frame. Plain data, published by the UserManager
+*	for the readers of other threads (display, metrics) which must not touch the tracking source.
+*/
+struct AttentionState
+{
+	uint64_t frame;				// 0 until the first frame is published
+	double time;				// of the tracking source (s)
+	unsigned int nbUsers;
+	bool jointAttention;		// every user watches the same screen
+	UserAttention users[Fubi::MaxUsers];	// closest user first
+
+	// index of a user, -1 if absent
+	int find(unsigned int userID) const
+	{
+		for (unsigned int i = 0; i < nbUsers; i++)
+		{
+			if (users[i].id == userID)
+				return (int)i;
+		}
+		return -1;
+	}
+};
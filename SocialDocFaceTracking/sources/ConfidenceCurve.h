@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include "tinyxml2.h"
+
+/**
+* \brief Confidence of the head rotation given by the face tracker, by distance to the sensor.
+*	The curve is a list of (distance, confidence) points linearly interpolated, 0 outside of them.
+*	It is compiled into a table with one value per millimeter, so that a lookup is one load.
+*/
+class ConfidenceCurve
+{
+public:
+	// covered distances (mm), farther users get 0
+	static const int MAX_DISTANCE = 5000;
+
+	ConfidenceCurve() : m_table(MAX_DISTANCE + 1, 0.0f)
+	{
+		setDefault();
+	}
+
+	// curve of the installation at numediart
+	void setDefault()
+	{
+		std::vector<std::pair<float, float> > points;
+		points.push_back(std::pair<float, float>(800.0f, 0.0f));
+		points.push_back(std::pair<float, float>(1000.0f, 1.0f));
+		points.push_back(std::pair<float, float>(1500.0f, 1.0f));
+		points.push_back(std::pair<float, float>(2000.0f, 0.8f));
+		points.push_back(std::pair<float, float>(2500.0f, 0.6f));
+		points.push_back(std::pair<float, float>(3000.0f, 0.4f));
+		points.push_back(std::pair<float, float>(4000.0f, 0.0f));
+		setPoints(points);
+	}
+
+	// pair<distance (mm), confidence [0..1]>, in any order
+	void setPoints(std::vector<std::pair<float, float> > points)
+	{
+		std::sort(points.begin(), points.end());
+		std::fill(m_table.begin(), m_table.end(), 0.0f);
+		for (unsigned int i = 1; i < points.size(); i++)
+		{
+			const std::pair<float, float>& p0 = points[i - 1];
+			const std::pair<float, float>& p1 = points[i];
+			int begin = std::max(0, (int)std::ceil(p0.first));
+			int end = std::min(MAX_DISTANCE + 1, (int)std::ceil(p1.first));
+			for (int d = begin; d < end; d++)
+				m_table[d] = p0.second + (p1.second - p0.second) * ((float)d - p0.first) / (p1.first - p0.first);
+		}
+	}
+
+	/**
+	* \brief Read the curve from a ConfidenceCurve element, distances in meters as the rest of the room configuration:
+	*	<ConfidenceCurve><Point><distance>0.8</distance><confidence>0</confidence></Point>...</ConfidenceCurve>
+	* \return false if the element is malformed, the curve is unchanged
+	*/
+	bool loadXML(tinyxml2::XMLElement* curve)
+	{
+		std::vector<std::pair<float, float> > points;
+		for (tinyxml2::XMLElement* point = curve->FirstChildElement("Point"); point != NULL; point = point->NextSiblingElement("Point"))
+		{
+			tinyxml2::XMLElement* distance = point->FirstChildElement("distance");
+			tinyxml2::XMLElement* confidence = point->FirstChildElement("confidence");
+			if (!distance || !confidence || !distance->GetText() || !confidence->GetText())
+			{
+				std::cerr << "ConfidenceCurve point without distance or confidence" << std::endl;
+				return false;
+			}
+			points.push_back(std::pair<float, float>((float)atof(distance->GetText()) * 1000.0f, (float)atof(confidence->GetText())));
+		}
+		if (points.size() < 2)
+		{
+			std::cerr << "ConfidenceCurve needs at least two points" << std::endl;
+			return false;
+		}
+		setPoints(points);
+		return true;
+	}
+
+	// distance in mm
+	float operator()(float distance) const
+	{
+		// also rejects NaN
+		if (!(distance >= 0.0f && distance <= (float)MAX_DISTANCE))
+			return 0.0f;
+		return m_table[(int)distance];
+	}
+
+	// confidences of several users at once
+	void evaluate(const float* distances, float* confidences, unsigned int count) const
+	{
+		for (unsigned int i = 0; i < count; i++)
+			confidences[i] = (*this)(distances[i]);
+	}
+
+private:
+	std::vector<float> m_table;
+};
@@ -0,0 +1,129 @@
+#include "ConfigWatcher.h"
+
+#include <iostream>
+#include <chrono>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <limits.h>
+#endif
+
+namespace
+{
+	// check the running flag at least this often
+	const int WATCH_TIMEOUT_MS = 200;
+	// editors write a file in several steps, wait for the last one
+	const int SETTLE_MS = 100;
+}
+
+
+ConfigWatcher::ConfigWatcher() :
+m_running(false), m_lastWrite(0), m_lastSize(0)
+#ifdef __linux__
+, m_inotify(-1)
+#endif
+{
+}
+
+
+ConfigWatcher::~ConfigWatcher()
+{
+	stop();
+}
+
+
+bool ConfigWatcher::start(const std::string& path, std::function<void()> onChange)
+{
+	stop();
+	m_path = path;
+	m_onChange = onChange;
+	pollChange();
+
+#ifdef __linux__
+	size_t slash = path.find_last_of('/');
+	std::string directory = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+	m_fileName = (slash == std::string::npos) ? path : path.substr(slash + 1);
+	m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_inotify < 0 || inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+	{
+		std::cerr << "Cannot watch " << path << ", changes will be polled" << std::endl;
+		if (m_inotify >= 0)
+			::close(m_inotify);
+		m_inotify = -1;
+	}
+#endif
+
+	m_running = true;
+	m_thread = std::thread(&ConfigWatcher::watchLoop, this);
+	std::cout << "Watching " << path << " for changes" << std::endl;
+	return true;
+}
+
+
+void ConfigWatcher::stop()
+{
+	m_running = false;
+	if (m_thread.joinable())
+		m_thread.join();
+#ifdef __linux__
+	if (m_inotify >= 0)
+		::close(m_inotify);
+	m_inotify = -1;
+#endif
+}
+
+
+bool ConfigWatcher::pollChange()
+{
+	struct stat st;
+	if (stat(m_path.c_str(), &st) != 0)
+		return false;
+	bool changed = (long long)st.st_mtime != m_lastWrite || (long long)st.st_size != m_lastSize;
+	m_lastWrite = (long long)st.st_mtime;
+	m_lastSize = (long long)st.st_size;
+	return changed;
+}
+
+
+void ConfigWatcher::watchLoop()
+{
+	while (m_running)
+	{
+		bool changed = false;
+#ifdef __linux__
+		if (m_inotify >= 0)
+		{
+			pollfd fd = { m_inotify, POLLIN, 0 };
+			if (poll(&fd, 1, WATCH_TIMEOUT_MS) <= 0)
+				continue;
+			char buffer[sizeof(inotify_event) + NAME_MAX + 1];
+			ssize_t size;
+			while ((size = read(m_inotify, buffer, sizeof(buffer))) > 0)
+			{
+				for (char* p = buffer; p < buffer + size; p += sizeof(inotify_event) + ((inotify_event*)p)->len)
+				{
+					const inotify_event* event = (const inotify_event*)p;
+					if (event->len > 0 && m_fileName == event->name)
+						changed = true;
+				}
+			}
+		}
+		else
+#endif
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_TIMEOUT_MS));
+			changed = pollChange();
+		}
+
+		if (changed && m_running)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_MS));
+			pollChange();
+			std::cout << m_path << " changed, reloading" << std::endl;
+			m_onChange();
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+/**
+* \brief Watches a configuration file on a background thread and calls back when it was rewritten.
+*	Uses inotify on Linux (on the directory, editors often replace the file), elsewhere
+*	the modification time is polled. The callback runs on the watcher thread.
+*/
+class ConfigWatcher
+{
+public:
+	ConfigWatcher();
+	~ConfigWatcher();
+
+	bool start(const std::string& path, std::function<void()> onChange);
+	void stop();
+
+private:
+	void watchLoop();
+	// true if the file changed since the last call
+	bool pollChange();
+
+	std::string m_path;
+	std::function<void()> m_onChange;
+	std::thread m_thread;
+	std::atomic<bool> m_running;
+
+	long long m_lastWrite;
+	long long m_lastSize;
+#ifdef __linux__
+	int m_inotify;
+	std::string m_fileName;
+#endif
+};
@@ -0,0 +1,81 @@
+#include "FacePanel.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+
+FacePanel::FacePanel() : m_userID(0)
+{
+	setUser(0);
+}
+
+
+void FacePanel::init()
+{
+	m_text.create(HEIGHT - FACE_HEIGHT, WIDTH, CV_8UC3);
+	m_text.setTo(cv::Scalar(0, 0, 0));
+	setUser(0);
+}
+
+
+void FacePanel::setUser(unsigned int userID)
+{
+	if (userID == m_userID && userID != 0)
+		return;
+	m_userID = userID;
+	m_name.clear();
+	for (unsigned int i = 0; i < NB_LINES; i++)
+		m_lines[i].drawn = false;
+	if (!m_text.empty())
+		m_text.setTo(cv::Scalar(0, 0, 0));
+}
+
+
+bool FacePanel::changed(unsigned int line, int value0, int value1)
+{
+	Line& l = m_lines[line];
+	if (l.drawn && l.values[0] == value0 && l.values[1] == value1)
+		return false;
+	l.values[0] = value0;
+	l.values[1] = value1;
+	l.drawn = true;
+	return true;
+}
+
+
+bool FacePanel::changed(const std::string& name, int screen)
+{
+	bool nameChanged = name != m_name;
+	if (nameChanged)
+		m_name = name;
+	// both values compared and kept
+	return changed(0, screen) || nameChanged;
+}
+
+
+void FacePanel::setLine(unsigned int line, const char* text)
+{
+	if (m_text.empty())
+		return;
+	// each line in its own band of rows, the baseline 2 rows above the next band
+	cv::Mat band = m_text.rowRange(line * LINE_HEIGHT + 2, (line + 1) * LINE_HEIGHT + 2);
+	band.setTo(cv::Scalar(0, 0, 0));
+	if (text)
+		cv::putText(band, text, cv::Point(8, LINE_HEIGHT - 2), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(255, 255, 255));
+}
+
+
+void FacePanel::draw(cv::Mat& panel) const
+{
+	if (m_text.empty())
+		return;
+	cv::Mat lines = panel.rowRange(FACE_HEIGHT, HEIGHT);
+	m_text.copyTo(lines);
+}
+
+
+void FacePanel::formatHundredths(char* text, int value)
+{
+	// the text only depends on the rounded value, as printf("%.2f") would show it
+	sprintf(text, "%s%d.%02d", value < 0 ? "-" : "", std::abs(value) / 100, std::abs(value) % 100);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <opencv2/opencv.hpp>
+
+/**
+* \brief Annotation lines shown under the face of one user, rasterized once in a canvas allocated at init.
+*	Each line keeps the rounded values it was drawn with and is only drawn again when one of them changes,
+*	so that the annotation of a user standing still costs a copy of the canvas.
+*/
+class FacePanel
+{
+public:
+	// face crop, then the lines of text
+	static const int WIDTH = 240;
+	static const int FACE_HEIGHT = 320;
+	static const unsigned int NB_LINES = 6;
+	static const int LINE_HEIGHT = 12;
+	static const int HEIGHT = FACE_HEIGHT + NB_LINES * LINE_HEIGHT + 4;
+
+	FacePanel();
+	// allocate the canvas, the lines are drawn for the next user
+	void init();
+	// user annotated, a new user clears the lines
+	void setUser(unsigned int userID);
+	unsigned int getUser() const { return m_userID; };
+
+	/**
+	* \brief Compare the values of a line with the ones it was drawn with.
+	* \return true if the line has to be drawn again with setLine, the values are kept as drawn
+	*/
+	bool changed(unsigned int line, int value0, int value1 = 0);
+	// name of the user, drawn in line 0 with the screen watched
+	bool changed(const std::string& name, int screen);
+	// replace the text of a line, NULL clears it
+	void setLine(unsigned int line, const char* text);
+
+	// copy the lines under the face of panel (WIDTH x HEIGHT)
+	void draw(cv::Mat& panel) const;
+
+	// value in hundredths as the text "-1.25"
+	static void formatHundredths(char* text, int value);
+
+private:
+	struct Line
+	{
+		int values[2];
+		bool drawn;
+	};
+
+	unsigned int m_userID;
+	std::string m_name;
+	Line m_lines[NB_LINES];
+	cv::Mat m_text;		// WIDTH x (HEIGHT - FACE_HEIGHT)
+};
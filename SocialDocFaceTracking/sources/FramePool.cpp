@@ -0,0 +1,93 @@
+#include "FramePool.h"
+
+#include <iostream>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#endif
+
+// cache line, and the widest vector loads of the image functions
+static const size_t BUFFER_ALIGNMENT = 64;
+
+
+FramePool::FramePool() : m_bufferSize(0)
+{
+}
+
+
+FramePool::~FramePool()
+{
+	free();
+}
+
+
+void FramePool::free()
+{
+	for (unsigned int i = 0; i < m_buffers.size(); i++)
+	{
+		if (m_buffers[i]->references != 0)
+			std::cerr << "Frame buffer released while still in use" << std::endl;
+#ifdef _MSC_VER
+		_aligned_free(m_buffers[i]->data);
+#else
+		::free(m_buffers[i]->data);
+#endif
+		delete m_buffers[i];
+	}
+	m_buffers.clear();
+	m_bufferSize = 0;
+}
+
+
+void FramePool::reserve(unsigned int count, int width, int height)
+{
+	size_t size = (size_t)std::max(width, 0) * std::max(height, 0) * 3;
+	if (count <= m_buffers.size() && size <= m_bufferSize)
+		return;
+
+	free();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Buffer* buffer = new Buffer();
+		buffer->references = 0;
+		buffer->data = 0;
+#ifdef _MSC_VER
+		buffer->data = (unsigned char*)_aligned_malloc(size, BUFFER_ALIGNMENT);
+#else
+		void* data = 0;
+		if (posix_memalign(&data, BUFFER_ALIGNMENT, size) == 0)
+			buffer->data = (unsigned char*)data;
+#endif
+		if (!buffer->data)
+		{
+			std::cerr << "Cannot allocate the frame buffers" << std::endl;
+			delete buffer;
+			free();
+			return;
+		}
+		m_buffers.push_back(buffer);
+	}
+	m_bufferSize = size;
+}
+
+
+FramePool::Frame FramePool::acquire(int width, int height)
+{
+	Frame frame;
+	if (width <= 0 || height <= 0 || (size_t)width * height * 3 > m_bufferSize)
+		return frame;
+	for (unsigned int i = 0; i < m_buffers.size(); i++)
+	{
+		// take the buffer if nobody else did
+		int free = 0;
+		if (m_buffers[i]->references.compare_exchange_strong(free, 1))
+		{
+			frame.m_buffer = m_buffers[i];
+			frame.m_image = cv::Mat(height, width, CV_8UC3, m_buffers[i]->data);
+			break;
+		}
+	}
+	return frame;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <opencv2/opencv.hpp>
+
+/**
+* \brief Image buffers allocated once and handed between the pipeline stages without copy.
+*	A Frame counts the references to its buffer, the buffer is free again when the last Frame
+*	referencing it is released, from any thread. The buffers are 64 bytes aligned and large
+*	enough for the biggest resolution reserved, so that a sensor switch does not allocate.
+*/
+class FramePool
+{
+	struct Buffer
+	{
+		std::atomic<int> references;	// 0 when free
+		unsigned char* data;
+	};
+
+public:
+	// reference to a buffer of the pool, with an image header on it (8 bits, 3 channels)
+	class Frame
+	{
+	public:
+		Frame() : m_buffer(0) {};
+		Frame(const Frame& frame) : m_buffer(frame.m_buffer), m_image(frame.m_image) { if (m_buffer) m_buffer->references++; };
+		~Frame() { release(); };
+		Frame& operator=(const Frame& frame)
+		{
+			if (frame.m_buffer)
+				frame.m_buffer->references++;
+			release();
+			m_buffer = frame.m_buffer;
+			m_image = frame.m_image;
+			return *this;
+		};
+
+		bool empty() const { return m_buffer == 0; };
+		cv::Mat& image() { return m_image; };
+		const cv::Mat& image() const { return m_image; };
+		void release()
+		{
+			if (m_buffer)
+				m_buffer->references--;
+			m_buffer = 0;
+			m_image = cv::Mat();
+		};
+
+	private:
+		friend class FramePool;
+		Buffer* m_buffer;
+		cv::Mat m_image;
+	};
+
+	FramePool();
+	~FramePool();
+
+	/**
+	* \brief Allocate count buffers for images up to width x height, when no frame is in use (start of the application).
+	*	Later calls with a smaller size do nothing.
+	*/
+	void reserve(unsigned int count, int width, int height);
+	/**
+	* \brief A free buffer for an image of width x height, never allocates.
+	* \return an empty frame if every buffer is in use (a stage is lagging) or the image is too large
+	*/
+	Frame acquire(int width, int height);
+
+	unsigned int getNbBuffers() const { return (unsigned int)m_buffers.size(); };
+
+private:
+	FramePool(const FramePool&);
+	FramePool& operator=(const FramePool&);
+	void free();
+
+	std::vector<Buffer*> m_buffers;
+	size_t m_bufferSize;
+};
@@ -0,0 +1,193 @@
+#include "FubiTrackingSource.h"
+
+#include <thread>
+
+// the Kinect gives 30 frames per second, polled a few times per frame
+static const std::chrono::microseconds SENSOR_PERIOD(33333);
+static const std::chrono::milliseconds POLL_PERIOD(2);
+
+
+FubiTrackingSource::FubiTrackingSource(Fubi::SensorType::Type sensorType, bool seatedSkel, const Fubi::FilterOptions & filter) :
+m_sensorType(sensorType), m_filter(filter), m_frameTimeStamp(0)
+{
+	if (seatedSkel)
+		m_profile = Fubi::SkeletonTrackingProfile::UPPER_BODY;
+	else
+		m_profile = Fubi::SkeletonTrackingProfile::ALL;
+}
+
+
+FubiTrackingSource::~FubiTrackingSource()
+{
+	Fubi::release();
+}
+
+
+bool FubiTrackingSource::init()
+{
+	return Fubi::init(Fubi::SensorOptions(Fubi::StreamOptions(), Fubi::StreamOptions(), Fubi::StreamOptions(-1, -1, -1), m_sensorType, m_profile, true, false), m_filter);
+}
+
+
+void FubiTrackingSource::update()
+{
+	Fubi::updateSensor();
+}
+
+
+bool FubiTrackingSource::waitForFrame(int timeoutMs)
+{
+	// Fubi does not signal the frames: a frame is new when the tracking data of the closest user is,
+	// without user the scene is read at the rate of the sensor
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (true)
+	{
+		Fubi::updateSensor();
+		double timeStamp = 0;
+		unsigned int closest = Fubi::getClosestUserID();
+		FubiUser::TrackingData* data = closest ? Fubi::getCurrentTrackingData(closest) : 0;
+		if (data)
+			timeStamp = data->timeStamp;
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (timeStamp != m_frameTimeStamp || now - m_frameClock >= SENSOR_PERIOD)
+		{
+			m_frameTimeStamp = timeStamp;
+			m_frameClock = now;
+			return true;
+		}
+		if (now - start >= std::chrono::milliseconds(timeoutMs))
+			return false;
+		std::this_thread::sleep_for(POLL_PERIOD);
+	}
+}
+
+
+double FubiTrackingSource::getCurrentTime()
+{
+	return Fubi::getCurrentTime();
+}
+
+
+bool FubiTrackingSource::switchToNextSensor()
+{
+	Fubi::SensorType::Type type = Fubi::getCurrentSensorType();
+	bool success = false;
+	while (!success)
+	{
+		if (type == Fubi::SensorType::NONE)
+			type = Fubi::SensorType::OPENNI2;
+		else if (type == Fubi::SensorType::OPENNI2)
+			type = Fubi::SensorType::OPENNI1;
+		else if (type == Fubi::SensorType::OPENNI1)
+			type = Fubi::SensorType::KINECTSDK;
+		else if (type == Fubi::SensorType::KINECTSDK)
+			type = Fubi::SensorType::NONE;
+
+		if (Fubi::isInitialized())
+			success = Fubi::switchSensor(Fubi::SensorOptions(Fubi::StreamOptions(), Fubi::StreamOptions(), Fubi::StreamOptions(-1, -1, -1),
+									type, Fubi::SkeletonTrackingProfile::UPPER_BODY, true, false));
+		else
+			success = Fubi::init(Fubi::SensorOptions(Fubi::StreamOptions(), Fubi::StreamOptions(), Fubi::StreamOptions(-1, -1, -1),
+									Fubi::SensorType::KINECTSDK, Fubi::SkeletonTrackingProfile::UPPER_BODY, true, false));
+
+		if (type == Fubi::SensorType::NONE)
+			break;	// None should always be successful so we ensure termination of this loop
+	}
+	m_users.clear();
+	return success;
+}
+
+
+void FubiTrackingSource::getRgbResolution(int& width, int& height)
+{
+	Fubi::getRgbResolution(width, height);
+}
+
+
+bool FubiTrackingSource::getImage(unsigned char* buffer, int renderOptions)
+{
+	return Fubi::getImage(buffer, Fubi::ImageType::Color, Fubi::ImageNumChannels::C3, Fubi::ImageDepth::D8, renderOptions, Fubi::RenderOptions::ALL_JOINTS);
+}
+
+
+std::deque<unsigned int> FubiTrackingSource::getClosestUserIDs()
+{
+	return Fubi::getClosestUserIDs();
+}
+
+
+TrackedUser* FubiTrackingSource::getUser(unsigned int userID)
+{
+	return refreshUser(userID);
+}
+
+
+Fubi::Vec3f FubiTrackingSource::getUserHeadCenter(unsigned int userID)
+{
+	std::vector<float> center = Fubi::getUserHeadCenter(userID);
+	if (center.size() < 3)
+		return Fubi::Vec3f(0, 0, 0);
+	return Fubi::Vec3f(center[0], center[1], center[2]);
+}
+
+
+Fubi::Vec3f FubiTrackingSource::getUserHeadRotation(unsigned int userID)
+{
+	std::vector<float> rotation = Fubi::getUserHeadRotation(userID);
+	if (rotation.size() < 3)
+		return Fubi::Vec3f(0, 0, 0);
+	return Fubi::Vec3f(rotation[0], rotation[1], rotation[2]);
+}
+
+
+std::string FubiTrackingSource::getUserName(unsigned int userID)
+{
+	return Fubi::getUserName(userID);
+}
+
+
+void FubiTrackingSource::updateUserScreenWatched(unsigned int userID, int screen)
+{
+	Fubi::updateUserScreenWatched(userID, screen);
+	refreshUser(userID);
+}
+
+
+void FubiTrackingSource::resetUserInterest(unsigned int userID)
+{
+	FubiUser* user = Fubi::getUser(userID);
+	if (user)
+	{
+		user->m_interestBegTime = Fubi::getCurrentTime();
+		user->m_interestTime = 0.0;
+	}
+	refreshUser(userID);
+}
+
+
+TrackedUser* FubiTrackingSource::refreshUser(unsigned int userID)
+{
+	FubiUser* user = Fubi::getUser(userID);
+	if (!user)
+		return 0;
+
+	TrackedUser& tracked = m_users[userID];
+	tracked.m_id = user->m_id;
+	tracked.m_isTracked = user->m_isTracked;
+	tracked.m_isFaceTracked = user->m_isFaceTracked;
+	tracked.m_faceRectCv = user->m_faceRectCv;
+	const Fubi::SkeletonJointPosition& torso = user->m_currentTrackingData->jointPositions[Fubi::SkeletonJoint::TORSO];
+	tracked.m_torsoPosition = torso.m_position;
+	tracked.m_torsoConfidence = torso.m_confidence;
+	for (int i = 0; i < Fubi::BodyMeasurement::NUM_MEASUREMENTS; i++)
+		tracked.m_bodyMeasurements[i] = user->m_bodyMeasurements[i];
+
+	tracked.m_screenWatched = user->m_screenWatched;
+	tracked.m_screenWatchedChanged = user->m_screenWatchedChanged;
+	tracked.m_interestTime = user->m_interestTime;
+	tracked.m_interestBegTime = user->m_interestBegTime;
+	tracked.m_interest = (TrackedUser::Interest)user->m_interest;
+	tracked.m_interestChanged = user->m_interestChanged;
+	return &tracked;
+}
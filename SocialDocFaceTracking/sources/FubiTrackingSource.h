@@ -0,0 +1,49 @@
+#pragma once
+
+#include "TrackingSource.h"
+
+#include <Fubi/Fubi.h>
+
+#include <map>
+#include <chrono>
+
+/**
+* \brief Live tracking from the Kinect, through the Fubi DLL (Windows only)
+*/
+class FubiTrackingSource : public ITrackingSource
+{
+public:
+	FubiTrackingSource(Fubi::SensorType::Type sensorType, bool seatedSkel,
+		const Fubi::FilterOptions & filter = Fubi::FilterOptions());
+	~FubiTrackingSource();
+
+	bool init();
+	void update();
+	bool waitForFrame(int timeoutMs);
+	double getCurrentTime();
+	bool switchToNextSensor();
+
+	void getRgbResolution(int& width, int& height);
+	bool getImage(unsigned char* buffer, int renderOptions);
+
+	std::deque<unsigned int> getClosestUserIDs();
+	TrackedUser* getUser(unsigned int userID);
+	Fubi::Vec3f getUserHeadCenter(unsigned int userID);
+	Fubi::Vec3f getUserHeadRotation(unsigned int userID);
+	std::string getUserName(unsigned int userID);
+	void updateUserScreenWatched(unsigned int userID, int screen);
+	void resetUserInterest(unsigned int userID);
+
+private:
+	// copy the state of the Fubi user in our cache
+	TrackedUser* refreshUser(unsigned int userID);
+
+	Fubi::SensorType::Type m_sensorType;
+	Fubi::SkeletonTrackingProfile::Profile m_profile;
+	Fubi::FilterOptions m_filter;
+
+	std::map<unsigned int, TrackedUser> m_users;
+	// last frame given by waitForFrame: tracking time stamp of the closest user, and when it was read
+	double m_frameTimeStamp;
+	std::chrono::steady_clock::time_point m_frameClock;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Fubi/FubiMath.h>
+
+/**
+* \brief Gaze of a user: head center and looking direction, in meters in the camera space.
+*	Fixed size, built on the stack for every face tracked user.
+*/
+struct GazeRay
+{
+	Fubi::Vec3f origin;
+	Fubi::Vec3f direction;	// unit vector
+
+	GazeRay() {};
+	GazeRay(const Fubi::Vec3f& orig, const Fubi::Vec3f& dir) : origin(orig), direction(dir) {};
+
+	/**
+	* \brief Head rotation matrix from the Euler angles in degrees (pitch, yaw, roll),
+	*	in closed form with the Fubi rotation order (YXZ): R = Ry(yaw) * Rx(pitch) * Rz(roll)
+	*/
+	static Fubi::Matrix3f headRotation(const Fubi::Vec3f& rotation)
+	{
+		float cx = std::cos(Fubi::degToRad(rotation.x)), sx = std::sin(Fubi::degToRad(rotation.x));
+		float cy = std::cos(Fubi::degToRad(rotation.y)), sy = std::sin(Fubi::degToRad(rotation.y));
+		float cz = std::cos(Fubi::degToRad(rotation.z)), sz = std::sin(Fubi::degToRad(rotation.z));
+
+		// Matrix3f is column major: c[column][row]
+		Fubi::Matrix3f m(Fubi::Math::NO_INIT);
+		m.c[0][0] = cy * cz + sy * sx * sz;	m.c[1][0] = -cy * sz + sy * sx * cz;	m.c[2][0] = sy * cx;
+		m.c[0][1] = cx * sz;				m.c[1][1] = cx * cz;					m.c[2][1] = -sx;
+		m.c[0][2] = -sy * cz + cy * sx * sz;	m.c[1][2] = sy * sz + cy * sx * cz;		m.c[2][2] = cy * cx;
+		return m;
+	}
+
+	/**
+	* \brief Gaze from the head pose given by the tracking source: center in mm, rotation in degrees.
+	*	The head looks at the camera (0, 0, -1) when it is not rotated.
+	*/
+	static GazeRay fromHead(const Fubi::Vec3f& center, const Fubi::Vec3f& rotation)
+	{
+		// third column of headRotation, negated
+		float cx = std::cos(Fubi::degToRad(rotation.x)), sx = std::sin(Fubi::degToRad(rotation.x));
+		float cy = std::cos(Fubi::degToRad(rotation.y)), sy = std::sin(Fubi::degToRad(rotation.y));
+		return GazeRay(center * 0.001f, Fubi::Vec3f(-sy * cx, sx, -cy * cx));
+	}
+};
@@ -1,53 +1,80 @@
 #include "KISDapp.h"
 #include "OSCUtils.h"
-#include <Fubi\Fubi.h>
+#include "tinyxml2.h"
 #include <iostream>
+#include <stdexcept>
+#include <chrono>
+
+// the tracking loop checks that it should still run at least this often
+static const int FRAME_TIMEOUT_MS = 200;
+// frame buffers: the raw image, and the annotated ones being rendered, queued (2) and displayed
+static const unsigned int NB_FRAME_BUFFERS = 5;
+// the buffers are large enough for the biggest colour image of the Kinect, for the sensor switches
+static const int MAX_RGB_WIDTH = 1280;
+static const int MAX_RGB_HEIGHT = 960;
 
 
 KISDapp::KISDapp(bool display) :
-showRgb(display), options(Fubi::RenderOptions::None), sendIntersection(false), jointAttentionState(false)
+manager(0), m_source(0), showRgb(display), options(Fubi::RenderOptions::None), sendIntersection(false),
+m_running(false), m_switchSensor(false), m_eventQueue(32), m_displayQueue(2), m_pendingClients(0)
 {
 }
 
 
 KISDapp::~KISDapp()
 {
-	// Now release Fubi
-	Fubi::release();
-	// And all allocated buffers
-	delete[] g_rgbData;
+	// no reload during the destruction
+	m_configWatcher.stop();
+	delete m_pendingClients.exchange(0);
 
 	// close OSC connections
 	m_sender.close();
 	m_receiver.close();
+
+	m_recorder.close();
+
+	// the faces not displayed yet are in buffers of the manager
+	{
+		DisplayFrame frame;
+		m_displayQueue.popLatest(frame);
+	}
+
+	// Now release the tracking source
+	delete manager;
+	delete m_source;
 }
 
 void KISDapp::init(const std::vector<std::string>& paths,
-	Fubi::SensorType::Type sensorType, 
-	bool seatedSkel, 
+	ITrackingSource* source,
 	DisplayOptions dispOpt,
 	std::vector<std::pair<std::string, int>> clientsIP,
 	bool sendGazeCoord,
-	std::vector<int> ports,
-	const Fubi::FilterOptions & filter)
+	std::vector<int> ports)
 {
 	setDisplayOptions(dispOpt);
 	sendIntersection = sendGazeCoord;
+	m_source = source;
 
-	Fubi::SkeletonTrackingProfile::Profile skelTrackPro;
-	if (seatedSkel)
-		skelTrackPro = Fubi::SkeletonTrackingProfile::UPPER_BODY;
-	else
-		skelTrackPro = Fubi::SkeletonTrackingProfile::ALL;
-
-	if (Fubi::init(Fubi::SensorOptions(Fubi::StreamOptions(), Fubi::StreamOptions(), Fubi::StreamOptions(-1, -1, -1), sensorType, skelTrackPro, true, false), filter))
+	if (m_source && m_source->init())
 	{
-		Fubi::getRgbResolution(rgbWidth, rgbHeight);
-			if (rgbWidth > 0 && rgbHeight > 0)
-				g_rgbData = new unsigned char[rgbWidth*rgbHeight * 3];
-			manager = new UserManager(showRgb, rgbWidth, rgbHeight, paths);
+		m_source->getRgbResolution(rgbWidth, rgbHeight);
+			// headless: the images are never read
+			bool renderImages = showRgb || m_streamer.isRunning();
+			if (renderImages && rgbWidth > 0 && rgbHeight > 0)
+				m_framePool.reserve(NB_FRAME_BUFFERS, std::max(rgbWidth, MAX_RGB_WIDTH), std::max(rgbHeight, MAX_RGB_HEIGHT));
+			manager = new UserManager(*m_source, renderImages, rgbWidth, rgbHeight, paths);
+			m_clientsIP = clientsIP;
+			if (!paths.empty())
+			{
+				m_configPath = paths.front();
+				loadOSCClients(m_configPath, clientsIP);
+			}
 			m_sender.init(clientsIP);
 			m_receiver.init(ports);
+
+			// apply the changes of the room configuration without restarting the sensor
+			if (!m_configPath.empty())
+				m_configWatcher.start(m_configPath, [this]() { reloadConfig(); });
 			
 			// test the connection
 			OSCMessage mes1;
@@ -57,23 +84,53 @@ void KISDapp::init(const std::vector<std::string>& paths,
 		return;
 	}	
 	else
-		throw std::exception("Initilisation failed");
+		throw std::runtime_error("Initilisation failed");
 }
 
 
 void KISDapp::run()
 {
+	m_running = true;
+	std::thread tracking(&KISDapp::trackingLoop, this);
+	std::thread emitter(&KISDapp::emitterLoop, this);
+
+	// display stage, HighGUI has to stay on the main thread
+	// (streamed only: no window, no HighGUI event pump)
+	bool displayStage = showRgb || m_streamer.isRunning();
 	int key = 0;
-	
+	while (displayStage && key != 'q' && m_running)
+	{
+		DisplayFrame frame;
+		if (m_displayQueue.popLatest(frame))
+			displayFrame(frame);
+
+		if (showRgb)
+			key = cv::waitKey(10);
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	// headless: the tracking thread runs until the end of the source
+	if (!displayStage)
+		tracking.join();
+
+	m_running = false;
+	if (tracking.joinable())
+		tracking.join();
+	emitter.join();
+}
+
+
+void KISDapp::trackingLoop()
+{
 	float fps = 0;
-	double time = Fubi::getCurrentTime();
+	double time = m_source->getCurrentTime();
 	int frames = 0;
 
-	while (key != 'q')
+	while (m_running)
 	{
 		//calculate fps every 2 seconds
 		frames++;
-		double newTime = Fubi::getCurrentTime();
+		double newTime = m_source->getCurrentTime();
 		if (newTime >= time + 2.0)
 		{
 			fps = (float)(frames / (newTime - time));
@@ -82,23 +139,46 @@ void KISDapp::run()
 		}
 
 
-		// Update the sensor	
-		Fubi::updateSensor();
+		if (m_switchSensor.exchange(false) && m_source->switchToNextSensor())
+		{
+			m_source->getRgbResolution(rgbWidth, rgbHeight);
+			if ((showRgb || m_streamer.isRunning()) && m_framePool.acquire(rgbWidth, rgbHeight).empty())
+				std::cerr << "No frame buffer for the images of the new sensor (" << rgbWidth << "x" << rgbHeight << ")" << std::endl;
+		}
+
+		// Update the sensor, paced by its frames
+		if (!m_source->waitForFrame(FRAME_TIMEOUT_MS))
+			continue;
+		if (m_source->isFinished())
+		{
+			std::cout << "End of the tracking source" << std::endl;
+			m_running = false;
+			break;
+		}
+
+		// native image for the face crops of the manager, only when they are displayed
+		// in the window or to a connected browser
+		bool renderImages = showRgb || m_streamer.hasClients();
+		FramePool::Frame raw;
+		if (renderImages)
+			raw = m_framePool.acquire(rgbWidth, rgbHeight);
+		cv::Mat rgb;
+		if (!raw.empty())
+		{
+			m_source->getImage(raw.image().data, Fubi::RenderOptions::SwapRAndB);
+			rgb = raw.image();
+		}
 
-		unsigned char* buffer = g_rgbData;
-		
-		// get native image for the manager
-		Fubi::ImageType::Type type = Fubi::ImageType::Color;
-		Fubi::ImageNumChannels::Channel numChannels = Fubi::ImageNumChannels::C3;
-		getImage(buffer, type, numChannels, Fubi::ImageDepth::D8, Fubi::RenderOptions::SwapRAndB);
-		cv::Mat rgb = cv::Mat(rgbHeight, rgbWidth, CV_8UC3, buffer);
-		
 
-		// get OSC messages
+		m_recorder.beginFrame(m_source->getCurrentTime());
+
+		// get all the OSC messages received since the last frame, never blocks
+		// (a replayed session also gives back the messages it recorded)
 		bool reset = false;
-		if (m_receiver.messageReceived())
+		OSCMessage messageReceived;
+		while (m_receiver.getMessage(messageReceived) || m_source->popEvent(messageReceived))
 		{
-			OSCMessage messageReceived = m_receiver.getMessage();
+			m_recorder.recordEvent(messageReceived);
 			if (messageReceived.text == "/player/next")
 			{
 				std::cout << "reinitialise time count" << std::endl;
@@ -108,132 +188,202 @@ void KISDapp::run()
 			
 		// update the manager
 		manager->update(rgb, reset);
+		m_recorder.endFrame();
 		
-		// send OSC messages
-		if (manager->nbUsersHasChanged())
-		{
-			//d::cout << "number of users changed : " << manager->getNbUsers() << std::endl;
-			OSCMessage message;
-			message.text = "/context/nbusers";
-			message.values.push_back((float)(manager->getNbUsers()));
-			m_sender.send(message);
-		}
-		if (manager->nbFaceTrackedUsersChanged())
+		// hand the events over to the emission stage
+		collectEvents(m_frameEvents);
+		if (m_frameEvents.nbEvents > 0 && !m_eventQueue.push(m_frameEvents))
+			std::cerr << "OSC emission is lagging, events of one frame dropped" << std::endl;
+
+		if (renderImages)
 		{
-			OSCMessage message;
-			message.text = "/context/facetrackedusers";
-			std::vector<unsigned short> tempusers = manager->getFaceTrackedUsers();
-			for (unsigned int i = 0; i < tempusers.size(); i++)
-				message.values.push_back((float)(tempusers[i]));
-			m_sender.send(message);
+			// get modified image to display, in its own buffer as the display stage keeps it
+			// (no free buffer: the display is lagging and simply misses this frame)
+			DisplayFrame frame;
+			frame.rgb = m_framePool.acquire(rgbWidth, rgbHeight);
+			if (!frame.rgb.empty())
+			{
+				m_source->getImage(frame.rgb.image().data, options);
+				frame.faces = manager->getFaces();
+				frame.fps = fps;
+				m_displayQueue.push(frame);
+			}
 		}
-		std::vector<unsigned short> attChange = manager->attentionChanged();
-		for (unsigned int i = 0; i < attChange.size(); i++)
-		{				
-			FubiUser* user = Fubi::getUser(attChange[i]);
+	}
+}
+
+
+void KISDapp::collectEvents(FrameEvents& events)
+{
+	events.nbEvents = 0;
+	UserEventView frameEvents = manager->getEvents();
+	for (const UserEvent* event = frameEvents.begin(); event != frameEvents.end(); ++event)
+	{
+		if (event->type == UserEvent::ATTENTION)
 			std::cout << "user attention engaged" << std::endl;
-			OSCMessage message;
-			message.text = "/context/user/attention";
-			message.values.push_back((float)(user->m_id));
-			message.values.push_back((float)user->m_screenWatched);
-			message.values.push_back((float)(user->m_interest));
-			m_sender.send(message);
-		}
-		if (manager->jointAttentionStart())
-		{
-			//std::cout << "joint attention engaged" << std::endl;
-			OSCMessage message;
-			message.text = "/context/jointattention";
-			message.values.push_back(1);
-			m_sender.send(message);
-			jointAttentionState = true;
-		}
-		if (manager->jointAttentionEnd())
+		else if (event->type == UserEvent::COORDINATES && !sendIntersection)
+			continue;
+		events.events[events.nbEvents++] = *event;
+	}
+}
+
+
+void KISDapp::emitterLoop()
+{
+	FrameEvents events;
+	std::string address;
+	float values[UserEvent::MAX_OSC_VALUES];
+	// keep going until the last queued events are sent
+	while (m_running || !m_eventQueue.empty())
+	{
+		// reloaded client list, the sockets are only touched by this thread
+		std::vector<std::pair<std::string, int>>* clients = m_pendingClients.exchange(0);
+		if (clients)
 		{
-			//std::cout << "joint attention stopped" << std::endl;
-			OSCMessage message;
-			message.text = "/context/jointattention";
-			message.values.push_back(0);
-			m_sender.send(message);
-			jointAttentionState = false;
+			m_sender.close();
+			m_sender.init(*clients);
+			delete clients;
 		}
-		if (sendIntersection)
-		{
-			std::map<int, cv::Point3f> intCoord = manager->intersectionCoordinates();
-			for (std::map<int, cv::Point3f>::iterator it = intCoord.begin(); it != intCoord.end(); ++it)
-			{
-				//std::cout << "send coordinates :" << std::endl;
-				OSCMessage message;
-				message.text = "/context/user/coordinates";
-				message.values.push_back(it->first);
-				message.values.push_back(it->second.z);
-				message.values.push_back(it->second.x);
-				message.values.push_back(it->second.y);
-				m_sender.send(message);
 
-			}
+		if (!m_eventQueue.pop(events))
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
 		}
-		if (showRgb)
+		// one bundle per client for the whole frame
+		m_sender.beginFrame();
+		for (unsigned int i = 0; i < events.nbEvents; i++)
 		{
-			// get modified image to display
-			getImage(buffer, type, numChannels, Fubi::ImageDepth::D8, options, Fubi::RenderOptions::ALL_JOINTS);
-			rgbMat = cv::Mat(rgbHeight, rgbWidth, CV_8UC3, buffer);
-			std::ostringstream oss;
-			oss.precision(3);
-			oss << "fps : " << fps;
-			cv::putText(rgbMat, oss.str(), cv::Point(9, 13), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0, 0, 0));
-			cv::putText(rgbMat, oss.str(), cv::Point(8, 12), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(255, 255, 255));
-			// display a green circle if joint attention
-			if (jointAttentionState)
-				cv::circle(rgbMat, cv::Point(rgbMat.size().width - 20, 20), 15, cv::Scalar(0, 255, 0), -1);
-			else
-				cv::circle(rgbMat, cv::Point(rgbMat.size().width - 20, 20), 15, cv::Scalar(0, 50, 0), -1);
-			cv::imshow("rgb", rgbMat);
+			unsigned int nbValues = events.events[i].toOSC(address, values);
+			m_sender.send(address, values, nbValues);
 		}
-
-		key = cv::waitKey(10);
+		m_sender.endFrame();
 	}
+}
 
-	// close OSC connections
 
+void KISDapp::reloadConfig()
+{
+	// parsed on the watcher thread, the frame loop only picks the new screens
+	KITV::ScreenManager* screens = new KITV::ScreenManager();
+	if (!screens->load(m_configPath))
+	{
+		std::cerr << "Keeping the previous room configuration" << std::endl;
+		delete screens;
+		return;
+	}
+	screens->printScreens();
+	manager->setScreenManager(screens);
+
+	std::vector<std::pair<std::string, int>>* clients = new std::vector<std::pair<std::string, int>>(m_clientsIP);
+	loadOSCClients(m_configPath, *clients);
+	// a list the emission stage did not pick yet is replaced
+	delete m_pendingClients.exchange(clients);
 }
 
 
-void KISDapp::startNextSensor()
+// <OSCClient><address>127.0.0.1</address><port>9000</port></OSCClient> elements of the RoomConfig
+void KISDapp::loadOSCClients(const std::string& path, std::vector<std::pair<std::string, int>>& clients)
 {
-	Fubi::SensorType::Type type = Fubi::getCurrentSensorType();
-	bool success = false;
-	while (!success)
+	tinyxml2::XMLDocument doc;
+	if (doc.LoadFile(path.c_str()) != 0 || !doc.FirstChildElement("RoomConfig"))
+		return;
+	tinyxml2::XMLElement* client = doc.FirstChildElement("RoomConfig")->FirstChildElement("OSCClient");
+	for (; client != NULL; client = client->NextSiblingElement("OSCClient"))
 	{
-		if (type == Fubi::SensorType::NONE)
-			type = Fubi::SensorType::OPENNI2;
-		else if (type == Fubi::SensorType::OPENNI2)
-			type = Fubi::SensorType::OPENNI1;
-		else if (type == Fubi::SensorType::OPENNI1)
-			type = Fubi::SensorType::KINECTSDK;
-		else if (type == Fubi::SensorType::KINECTSDK)
-			type = Fubi::SensorType::NONE;
-
-		if (Fubi::isInitialized())
-			success = Fubi::switchSensor(Fubi::SensorOptions(Fubi::StreamOptions(), Fubi::StreamOptions(), Fubi::StreamOptions(-1, -1, -1),
-									type, Fubi::SkeletonTrackingProfile::UPPER_BODY, true, false));
+		tinyxml2::XMLElement* address = client->FirstChildElement("address");
+		tinyxml2::XMLElement* port = client->FirstChildElement("port");
+		if (address && port && address->GetText() && port->GetText())
+			clients.push_back(std::pair<std::string, int>(address->GetText(), atoi(port->GetText())));
 		else
-			success = Fubi::init(Fubi::SensorOptions(Fubi::StreamOptions(), Fubi::StreamOptions(), Fubi::StreamOptions(-1, -1, -1), 
-									Fubi::SensorType::KINECTSDK, Fubi::SkeletonTrackingProfile::UPPER_BODY, true, false));
+			std::cerr << "OSCClient without address or port in " << path << std::endl;
+	}
+}
 
-		if (success)
-		{
 
-			Fubi::getRgbResolution(rgbWidth, rgbHeight);
+void KISDapp::displayFrame(DisplayFrame& frame)
+{
+	// colour image and overlays in the mosaic, shown with the faces in one window
+	const cv::Mat& image = frame.rgb.image();
+	if (image.cols != m_windowManager.getWidth() || image.rows != m_windowManager.getHeight())
+		m_windowManager.init(image.cols, image.rows);
+	cv::Mat& rgb = m_windowManager.getMainView();
+	image.copyTo(rgb);
+	frame.rgb.release();
+
+	std::ostringstream oss;
+	oss.precision(3);
+	oss << "fps : " << frame.fps;
+	cv::putText(rgb, oss.str(), cv::Point(9, 13), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0, 0, 0));
+	cv::putText(rgb, oss.str(), cv::Point(8, 12), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(255, 255, 255));
 
-				delete[] g_rgbData;
-				if (rgbWidth > 0 && rgbHeight > 0)
-					g_rgbData = new unsigned char[rgbWidth*rgbHeight * 3];
-		}
+	// latest attention, published by the tracking thread
+	AttentionState attention;
+	manager->getAttention(attention);
+	// display a green circle if joint attention
+	if (attention.jointAttention)
+		cv::circle(rgb, cv::Point(rgb.size().width - 20, 20), 15, cv::Scalar(0, 255, 0), -1);
+	else
+		cv::circle(rgb, cv::Point(rgb.size().width - 20, 20), 15, cv::Scalar(0, 50, 0), -1);
 
-		if (type == Fubi::SensorType::NONE)
-			break;	// None should always be successful so we ensure termination of this loop
+	// the faces are copied in their tiles, their buffers go back to the pool of the manager
+	for (unsigned int i = 0; i < frame.faces.size(); i++)
+		m_windowManager.setFace(frame.faces[i].first, frame.faces[i].second.image());
+	frame.faces.clear();
+	unsigned int activeUsers[Fubi::MaxUsers];
+	for (unsigned int i = 0; i < attention.nbUsers; i++)
+		activeUsers[i] = attention.users[i].id;
+	m_windowManager.clearUnused(activeUsers, attention.nbUsers);
+	if (showRgb)
+		m_windowManager.show();
+	else
+		m_windowManager.render();
+	// copied only while a browser is connected, encoded on the thread of the server
+	m_streamer.publish(m_windowManager.getMosaic());
+}
+
+
+bool KISDapp::startRecording(const std::string& path)
+{
+	if (!m_recorder.open(path))
+		return false;
+	manager->setRecorder(&m_recorder);
+	return true;
+}
+
+
+void KISDapp::setUserBudget(unsigned int fullRateUsers)
+{
+	manager->setBudget(fullRateUsers);
+	std::cout << "Full rate analysis for the " << fullRateUsers << " most reliable users" << std::endl;
+}
+
+
+void KISDapp::setEngagementRate(float rate)
+{
+	manager->setEngagement(rate);
+	if (rate > 0)
+		std::cout << "Engagement sent " << rate << " times per second" << std::endl;
+	else
+		std::cout << "Engagement not sent" << std::endl;
+}
+
+
+bool KISDapp::startStreaming(const std::string& address, int port)
+{
+	if (manager)
+	{
+		std::cerr << "The stream must be started before the initialisation" << std::endl;
+		return false;
 	}
+	return m_streamer.start(address, port);
+}
+
+
+void KISDapp::startNextSensor()
+{
+	// the images of the new sensor use the frame buffers allocated at start
+	m_switchSensor = true;
 }
 
 void KISDapp::setDisplayOptions(DisplayOptions dispOpt)
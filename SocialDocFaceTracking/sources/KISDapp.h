@@ -4,18 +4,26 @@
 #include "OSCSender.h"
 #include "OSCReceiver.h"
 
-#include <Fubi\Fubi.h>
-#include <Fubi\FubiUtils.h>
+#include <Fubi/FubiUtils.h>
 
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <queue>
+#include <thread>
+#include <atomic>
 
-#include <opencv2\opencv.hpp>
+#include <opencv2/opencv.hpp>
 
 
 #include "UserManager.h"
+#include "WindowManager.h"
+#include "MjpegServer.h"
+#include "RingBuffer.h"
+#include "SessionRecorder.h"
+#include "TrackingSource.h"
+#include "ConfigWatcher.h"
+#include "FramePool.h"
 
 struct DisplayOptions
 {
@@ -37,21 +45,51 @@ struct DisplayOptions
 		{};
 };
 
+// events produced by the analysis of one frame, consumed by the emission stage
+// (plain data: queued by copy, without allocation)
+struct FrameEvents
+{
+	unsigned int nbEvents;
+	UserEvent events[UserManager::MAX_EVENTS];
+	FrameEvents() : nbEvents(0) {};
+};
+
+// images the display stage needs to render one frame, the attention is read from the
+// state published by the manager
+struct DisplayFrame
+{
+	FramePool::Frame rgb;	// annotated image, in a buffer of the frame pool
+	std::vector<std::pair<unsigned int, FramePool::Frame> > faces;
+	float fps;
+	DisplayFrame() : fps(0) {};
+};
+
 class KISDapp //: public QWidget
 {
 public:
 	KISDapp(bool display = true);
 	~KISDapp();
+	// the application takes ownership of the tracking source
 	void init(const std::vector<std::string>& paths,
-		Fubi::SensorType::Type sensorType,
-		bool seatedSkel,
+		ITrackingSource* source,
 		DisplayOptions dispOpt = DisplayOptions(),
 		std::vector<std::pair<std::string, int>> clientsIP = std::vector<std::pair<std::string, int>>(),
 		bool sendGazeCoord = false,
-		std::vector<int> ports = std::vector<int>(),
-		const Fubi::FilterOptions & filter = Fubi::FilterOptions());
+		std::vector<int> ports = std::vector<int>());
 	void run();
+	// switch sensor, done by the tracking thread at its next frame
 	void startNextSensor();
+	// write all the tracking data and received OSC messages to a binary log
+	bool startRecording(const std::string& path);
+	// full analysis for the fullRateUsers most reliable users only, see UserManager::setBudget
+	void setUserBudget(unsigned int fullRateUsers);
+	// engagement scores sent rate times per second, 0 to stop, see UserManager::setEngagement
+	void setEngagementRate(float rate);
+	/**
+	* \brief Stream the display as MJPEG on http://address:port/, with or without its window.
+	*	To call before init, the images are only rendered while a browser is connected.
+	*/
+	bool startStreaming(const std::string& address, int port);
 
 	UserManager* manager;
 
@@ -59,19 +97,47 @@ public:
 private:
 	void setDisplayOptions(DisplayOptions dispOpt);
 
+	// pipeline stages: capture and attention analysis share the tracking thread
+	// (the user data of the source is only valid until its next update), event emission
+	// has its own thread and the display runs on the main thread (HighGUI)
+	void trackingLoop();
+	void emitterLoop();
+	void displayFrame(DisplayFrame& frame);
+	void collectEvents(FrameEvents& events);
+
+	// called by the configuration watcher when the room configuration file changed
+	void reloadConfig();
+	// OSC clients listed in the room configuration, added to clients
+	static void loadOSCClients(const std::string& path, std::vector<std::pair<std::string, int>>& clients);
+
+	ITrackingSource* m_source;
 	OSCSender m_sender;
 	OSCReceiver m_receiver;
+	WindowManager m_windowManager;
+	MjpegServer m_streamer;
+	SessionRecorder m_recorder;
+
+	std::atomic<bool> m_running;
+	std::atomic<bool> m_switchSensor;
+	// raw and annotated images, before the display queue which holds some of them
+	FramePool m_framePool;
+	RingBuffer<FrameEvents> m_eventQueue;
+	FrameEvents m_frameEvents;	// filled by the tracking thread
+	RingBuffer<DisplayFrame> m_displayQueue;
+
+	// hot reload of the room configuration: screens are handed to the manager, the OSC clients
+	// (command line ones plus the ones of the file) to the emission stage
+	ConfigWatcher m_configWatcher;
+	std::string m_configPath;
+	std::vector<std::pair<std::string, int>> m_clientsIP;
+	std::atomic<std::vector<std::pair<std::string, int>>*> m_pendingClients;
 
 
 	int rgbWidth = 0, rgbHeight = 0;
 
-	// buffers and Mat
-	unsigned char* g_rgbData = 0x0;
-	cv::Mat rgbMat;
 	bool showRgb;
 	bool sendIntersection;
 
-	bool jointAttentionState;
 	unsigned int options;
 };
 
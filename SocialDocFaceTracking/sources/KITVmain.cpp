@@ -1,6 +1,34 @@
 #include "KISDapp.h"
 #include "commandParser.h"
-#include <windows.h>
+#include "ReplayTrackingSource.h"
+#include "SyntheticTrackingSource.h"
+#ifdef _WIN32
+#include "FubiTrackingSource.h"
+#endif
+
+#include <thread>
+#include <chrono>
+
+
+// -source kinect | replay:file.kisd | synthetic:nbUsers
+ITrackingSource* createTrackingSource(const std::string& source)
+{
+	if (source.compare(0, 7, "replay:") == 0)
+		return new ReplayTrackingSource(source.substr(7));
+	if (source.compare(0, 9, "synthetic") == 0)
+	{
+		unsigned int nbUsers = 3;
+		if (source.size() > 10)
+			nbUsers = std::stoi(source.substr(10));
+		return new SyntheticTrackingSource(nbUsers);
+	}
+#ifdef _WIN32
+	return new FubiTrackingSource(Fubi::SensorType::KINECTSDK, true);
+#else
+	std::cout << "The Kinect is only available on Windows, using a synthetic crowd" << std::endl;
+	return new SyntheticTrackingSource(3);
+#endif
+}
 
 
 int main(int argc, char ** argv)
@@ -10,6 +38,12 @@ int main(int argc, char ** argv)
 	std::vector<int> ports;
 	bool display = true;
 	bool sendCoord = false;
+	std::string recordFile;
+	std::string source = "kinect";
+	int budget = 0;
+	float engagementRate = -1;
+	std::string streamAddress = "127.0.0.1";
+	int streamPort = 0;
 
 	if (argc > 1)
 	{
@@ -102,6 +136,36 @@ int main(int argc, char ** argv)
 			std::cout << "No OSC listener found" << std::endl;
 			std::cout << "Please, use -osclistenerX [port] option to use them with X = [1; 2; 3...]\n" << std::endl;
 		}
+
+		// record the tracking session to a binary file
+		CommandParser::parse_argument(argc, argv, "-record", recordFile);
+
+		// tracking data from the Kinect (default), a recorded session or a synthetic crowd
+		CommandParser::parse_argument(argc, argv, "-source", source);
+
+		// number of users analysed at every frame, the others less often (all by default)
+		std::string budgetArg;
+		if (CommandParser::parse_argument(argc, argv, "-budget", budgetArg) > 0)
+			budget = std::stoi(budgetArg);
+
+		// engagement scores per second (2 by default, 0: not sent)
+		std::string engagementArg;
+		if (CommandParser::parse_argument(argc, argv, "-engagement", engagementArg) > 0)
+			engagementRate = std::stof(engagementArg);
+
+		// MJPEG stream of the display, [address:]port, on the local machine only by default
+		std::string streamArg;
+		if (CommandParser::parse_argument(argc, argv, "-stream", streamArg) > 0)
+		{
+			size_t found = streamArg.find(":");
+			if (found != std::string::npos)
+			{
+				streamAddress = streamArg.substr(0, found);
+				streamPort = std::stoi(streamArg.substr(found + 1));
+			}
+			else
+				streamPort = std::stoi(streamArg);
+		}
 	}
 	else
 	{
@@ -112,20 +176,28 @@ int main(int argc, char ** argv)
 	try
 	{
 		KISDapp kisd(display);
+		if (streamPort > 0)
+			kisd.startStreaming(streamAddress, streamPort);
 		DisplayOptions dopt;
 		dopt.skeletons = true;
 		dopt.useFilter = true;
 		dopt.faceDetails = true;
 		dopt.fingers = true;
 
-		kisd.init(paths, Fubi::SensorType::KINECTSDK, true, dopt, clientsIP, sendCoord, ports);
+		kisd.init(paths, createTrackingSource(source), dopt, clientsIP, sendCoord, ports);
+		if (!recordFile.empty())
+			kisd.startRecording(recordFile);
+		if (budget > 0)
+			kisd.setUserBudget(budget);
+		if (engagementRate >= 0)
+			kisd.setEngagementRate(engagementRate);
 		kisd.run();
 	}
 	catch (std::exception& e)
 	{
 		std::cerr << e.what() << std::endl;
 			  
-		Sleep(2000);
+		std::this_thread::sleep_for(std::chrono::seconds(2));
 	}
 	return 0;
 }
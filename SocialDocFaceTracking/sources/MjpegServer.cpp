@@ -0,0 +1,287 @@
+#include "MjpegServer.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_MSC_VER) || defined(WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+	const char* BOUNDARY = "kisdframe";
+	// wait at most this long for a connection or a frame, so that stop() is noticed quickly
+	const int IO_TIMEOUT_MS = 100;
+	// a client which cannot take a frame in this time is dropped
+	const int SEND_TIMEOUT_MS = 1000;
+
+	void closeSocket(int handle)
+	{
+#if defined(_MSC_VER) || defined(WIN32)
+		::closesocket(handle);
+#else
+		::close(handle);
+#endif
+	}
+
+	bool waitReadable(int handle, int timeoutMs)
+	{
+		fd_set set;
+		FD_ZERO(&set);
+		FD_SET(handle, &set);
+		timeval timeout;
+		timeout.tv_sec = timeoutMs / 1000;
+		timeout.tv_usec = (timeoutMs % 1000) * 1000;
+		return select(handle + 1, &set, 0, 0, &timeout) > 0;
+	}
+
+	bool sendAll(int handle, const char* data, size_t size)
+	{
+#ifdef MSG_NOSIGNAL
+		// a closed browser tab must not kill the application
+		const int flags = MSG_NOSIGNAL;
+#else
+		const int flags = 0;
+#endif
+		while (size > 0)
+		{
+			int sent = (int)send(handle, data, (int)size, flags);
+			if (sent <= 0)
+				return false;
+			data += sent;
+			size -= sent;
+		}
+		return true;
+	}
+
+	// the encoding gives way to the tracking and the display
+	void lowerThreadPriority()
+	{
+#if defined(_MSC_VER) || defined(WIN32)
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__linux__)
+		sched_param param;
+		param.sched_priority = 0;
+		pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+	}
+}
+
+
+MjpegServer::MjpegServer() :
+m_listener(-1), m_nbClients(0), m_running(false), m_minInterval(0), m_hasPending(false)
+{
+#if defined(_MSC_VER) || defined(WIN32)
+	WSADATA wsaData;
+	WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+}
+
+
+MjpegServer::~MjpegServer()
+{
+	stop();
+#if defined(_MSC_VER) || defined(WIN32)
+	WSACleanup();
+#endif
+}
+
+
+bool MjpegServer::start(const std::string& address, int port, float maxFps, int quality)
+{
+	stop();
+
+	sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_port = htons((unsigned short)port);
+	if (inet_pton(AF_INET, address.c_str(), &local.sin_addr) != 1)
+	{
+		std::cerr << "Cannot start the stream: invalid address " << address << std::endl;
+		return false;
+	}
+
+	m_listener = (int)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	int reuse = 1;
+	if (m_listener >= 0)
+		setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+	if (m_listener < 0 || bind(m_listener, (const sockaddr*)&local, sizeof(local)) != 0 || listen(m_listener, (int)MAX_CLIENTS) != 0)
+	{
+		std::cerr << "Cannot start the stream on " << address << ":" << port << std::endl;
+		stop();
+		return false;
+	}
+
+	m_minInterval = maxFps > 0 ? 1.0 / maxFps : 0.0;
+	m_params.clear();
+	m_params.push_back(cv::IMWRITE_JPEG_QUALITY);
+	m_params.push_back(quality);
+	m_running = true;
+	m_thread = std::thread(&MjpegServer::serverLoop, this);
+	std::cout << "Streaming the display on http://" << address << ":" << port << "/" << std::endl;
+	return true;
+}
+
+
+void MjpegServer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+	m_frameReady.notify_all();
+	if (m_thread.joinable())
+		m_thread.join();
+
+	for (unsigned int i = 0; i < m_clients.size(); i++)
+		closeSocket(m_clients[i]);
+	m_clients.clear();
+	m_nbClients = 0;
+	if (m_listener >= 0)
+		closeSocket(m_listener);
+	m_listener = -1;
+	m_hasPending = false;
+}
+
+
+void MjpegServer::publish(const cv::Mat& image)
+{
+	if (!hasClients())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		// same size from one frame to the next: no allocation
+		image.copyTo(m_pending);
+		m_hasPending = true;
+	}
+	m_frameReady.notify_one();
+}
+
+
+void MjpegServer::serverLoop()
+{
+	lowerThreadPriority();
+	std::chrono::steady_clock::time_point nextFrame = std::chrono::steady_clock::now();
+
+	while (m_running)
+	{
+		// nobody watching: only wait for a connection
+		acceptClients();
+		if (m_clients.empty())
+			continue;
+
+		bool hasFrame = false;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_frameReady.wait_for(lock, std::chrono::milliseconds(IO_TIMEOUT_MS), [this]() { return m_hasPending || !m_running; });
+			if (m_hasPending)
+			{
+				// the latest image, the ones published meanwhile were never copied out
+				cv::swap(m_pending, m_encoded);
+				m_hasPending = false;
+				hasFrame = true;
+			}
+		}
+		if (!hasFrame)
+			continue;
+
+		sendFrame();
+		// at most maxFps frames per second
+		nextFrame += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_minInterval));
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (nextFrame > now)
+			std::this_thread::sleep_until(nextFrame);
+		else
+			nextFrame = now;
+	}
+}
+
+
+void MjpegServer::acceptClients()
+{
+	// without client, the wait for a connection paces the loop
+	int timeout = m_clients.empty() ? IO_TIMEOUT_MS : 0;
+	while (waitReadable(m_listener, timeout))
+	{
+		timeout = 0;
+		int client = (int)accept(m_listener, 0, 0);
+		if (client < 0)
+			return;
+
+		// any GET request, the rest of it is ignored
+		char request[1024];
+		int size = waitReadable(client, IO_TIMEOUT_MS) ? (int)recv(client, request, sizeof(request), 0) : 0;
+		if (size < 4 || strncmp(request, "GET ", 4) != 0)
+		{
+			closeSocket(client);
+			continue;
+		}
+		if (m_clients.size() >= MAX_CLIENTS)
+		{
+			const char* busy = "HTTP/1.0 503 Service Unavailable\r\nConnection: close\r\n\r\n";
+			sendAll(client, busy, strlen(busy));
+			closeSocket(client);
+			continue;
+		}
+
+#if defined(_MSC_VER) || defined(WIN32)
+		DWORD sendTimeout = SEND_TIMEOUT_MS;
+#else
+		timeval sendTimeout;
+		sendTimeout.tv_sec = SEND_TIMEOUT_MS / 1000;
+		sendTimeout.tv_usec = (SEND_TIMEOUT_MS % 1000) * 1000;
+#endif
+		setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char*)&sendTimeout, sizeof(sendTimeout));
+
+		char header[256];
+		sprintf(header, "HTTP/1.0 200 OK\r\nCache-Control: no-cache\r\nPragma: no-cache\r\nConnection: close\r\n"
+			"Content-Type: multipart/x-mixed-replace; boundary=%s\r\n\r\n", BOUNDARY);
+		if (!sendAll(client, header, strlen(header)))
+		{
+			closeSocket(client);
+			continue;
+		}
+		m_clients.push_back(client);
+		m_nbClients = (unsigned int)m_clients.size();
+	}
+}
+
+
+void MjpegServer::sendFrame()
+{
+	if (m_encoded.empty() || !cv::imencode(".jpg", m_encoded, m_jpeg, m_params))
+		return;
+
+	char header[128];
+	sprintf(header, "--%s\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n", BOUNDARY, (unsigned int)m_jpeg.size());
+	for (unsigned int i = (unsigned int)m_clients.size(); i-- > 0;)
+	{
+		int client = m_clients[i];
+		if (!sendAll(client, header, strlen(header))
+			|| !sendAll(client, (const char*)&m_jpeg[0], m_jpeg.size())
+			|| !sendAll(client, "\r\n", 2))
+			closeClient(i);
+	}
+}
+
+
+void MjpegServer::closeClient(unsigned int index)
+{
+	closeSocket(m_clients[index]);
+	m_clients.erase(m_clients.begin() + index);
+	m_nbClients = (unsigned int)m_clients.size();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <opencv2/opencv.hpp>
+
+/**
+* \brief Minimal HTTP server streaming the debug mosaic as MJPEG (multipart/x-mixed-replace),
+*	to look at the tracker from a browser without a monitor on the installation PC.
+*	Any GET request gets the stream. The server, the JPEG encoding and the sends run on one thread
+*	of low priority. The display stage only copies its mosaic while a client is connected, and
+*	only the latest mosaic is encoded, at most maxFps times per second.
+*/
+class MjpegServer
+{
+public:
+	static const unsigned int MAX_CLIENTS = 4;
+
+	MjpegServer();
+	~MjpegServer();
+
+	/**
+	* \brief Listen on address:port, "127.0.0.1" for the local machine only, "0.0.0.0" for every interface.
+	* \return false if the port cannot be opened
+	*/
+	bool start(const std::string& address, int port, float maxFps = 10.0f, int quality = 80);
+	void stop();
+	bool isRunning() const { return m_running; };
+	// a browser is watching, worth rendering the images
+	bool hasClients() const { return m_nbClients.load(std::memory_order_relaxed) > 0; };
+
+	// image to stream (8 bits, 3 channels), copied only if a client is connected, never blocks on the network
+	void publish(const cv::Mat& image);
+
+private:
+	MjpegServer(const MjpegServer&);
+	MjpegServer& operator=(const MjpegServer&);
+
+	void serverLoop();
+	// take the pending connections, answer their request with the stream header
+	void acceptClients();
+	// encode the latest image and send it to every client, the failing ones are closed
+	void sendFrame();
+	void closeClient(unsigned int index);
+
+	int m_listener;
+	std::vector<int> m_clients;
+	std::atomic<unsigned int> m_nbClients;
+	std::atomic<bool> m_running;
+	std::thread m_thread;
+	double m_minInterval;	// s between two frames sent
+	std::vector<int> m_params;
+
+	// latest image published, swapped with the one encoded
+	std::mutex m_mutex;
+	std::condition_variable m_frameReady;
+	cv::Mat m_pending;
+	bool m_hasPending;
+	cv::Mat m_encoded;
+	std::vector<unsigned char> m_jpeg;
+};
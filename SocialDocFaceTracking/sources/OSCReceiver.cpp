@@ -1,17 +1,53 @@
 #include "OSCReceiver.h"
 
-OSCReceiver::OSCReceiver()
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// wait at most this long for data, so that close() is noticed quickly
+	const int IO_TIMEOUT_MS = 100;
+
+	void setNonBlocking(int handle)
+	{
+#if defined(_MSC_VER) || defined(WIN32)
+		u_long mode = 1;
+		ioctlsocket(handle, FIONBIO, &mode);
+#else
+		fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK);
+#endif
+	}
+}
+
+
+OSCReceiver::OSCReceiver() :
+m_running(false), m_messages(256), m_verbose(true)
+#ifdef __linux__
+, m_epoll(-1)
+#endif
 {
 }
 
 
 OSCReceiver::~OSCReceiver()
 {
+	close(false);
 }
 
 
 void OSCReceiver::init(std::vector<int> ports, bool verbose)
 {
+	m_verbose = verbose;
+	// large enough for any UDP datagram
+	m_packet.resize(1024 * 64);
+
+#ifdef __linux__
+	m_epoll = epoll_create1(0);
+#endif
+
 	for (unsigned int i = 0; i < ports.size(); i++)
 	{
 		oscListeners.push_back(new OSCListener);
@@ -23,79 +59,164 @@ void OSCReceiver::init(std::vector<int> ports, bool verbose)
 		}
 		else
 		{
+			setNonBlocking(oscListeners[i]->sock.socketHandle());
+#ifdef __linux__
+			epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.ptr = oscListeners[i];
+			epoll_ctl(m_epoll, EPOLL_CTL_ADD, oscListeners[i]->sock.socketHandle(), &ev);
+#endif
 			if (verbose)
 				std::cout << "Server started, will listen to packets on port " << oscListeners[i]->port << std::endl;
 		}
 	}
+
+	if (!oscListeners.empty())
+	{
+		m_running = true;
+		m_ioThread = std::thread(&OSCReceiver::receiveLoop, this);
+	}
 }
 
 
-bool OSCReceiver::messageReceived(bool verbose)
+bool OSCReceiver::messageReceived()
 {
-	bool newMessage = false;
+	return !m_messages.empty();
+}
+
+
+bool OSCReceiver::getMessage(OSCMessage& mes, bool verbose)
+{
+	if (!m_messages.pop(mes))
+		return false;
+
+	if (verbose)
+	{
+		std::cout << mes.text;
+		for (unsigned int k = 0; k < mes.values.size(); k++)
+			std::cout << " " << mes.values[k];
+		std::cout << std::endl;
+	}
+	return true;
+}
+
+
+void OSCReceiver::close(bool verbose)
+{
+	m_running = false;
+	if (m_ioThread.joinable())
+		m_ioThread.join();
+
 	for (unsigned int i = 0; i < oscListeners.size(); i++)
 	{
-		bool temp = false;
 		if (oscListeners[i]->sock.isOk())
+			oscListeners[i]->sock.close();
+		delete oscListeners[i];
+	}
+	oscListeners.clear();
+
+#ifdef __linux__
+	if (m_epoll != -1)
+		::close(m_epoll);
+	m_epoll = -1;
+#endif
+}
+
+
+void OSCReceiver::parsePacket(const void* data, size_t size, std::vector<OSCMessage>& messages)
+{
+	oscpkt::PacketReader pr(data, size);
+	oscpkt::Message *msg;
+	while (pr.isOk() && (msg = pr.popMessage()) != 0)
+	{
+		OSCMessage mr;
+		mr.text = msg->addressPattern();
+
+		// values are forwarded as floats, other argument types are skipped
+		oscpkt::Message::ArgReader argRead(msg->arg());
+		while (argRead.isOk() && argRead.nbArgRemaining() > 0)
 		{
-			temp = oscListeners[i]->sock.receiveNextPacket(10 /* timeout, in ms */);
-			if (temp && verbose)
-				std::cout << "message received on port " << oscListeners[i]->port << std::endl;
+			if (argRead.isFloat())
+			{
+				float farg;
+				argRead.popFloat(farg);
+				mr.values.push_back(farg);
+			}
+			else if (argRead.isInt32())
+			{
+				int32_t iarg;
+				argRead.popInt32(iarg);
+				mr.values.push_back((float)iarg);
+			}
+			else
+				argRead.pop();
 		}
-		newMessage |= temp;
+		messages.push_back(mr);
 	}
-	return newMessage;
 }
 
 
-OSCMessage OSCReceiver::getMessage(bool verbose)
+void OSCReceiver::receiveLoop()
 {
-	OSCMessage mr;
-	for (unsigned int i = 0; i < oscListeners.size(); i++)
+	while (m_running)
 	{
-		if (oscListeners[i]->sock.isOk())
+#ifdef __linux__
+		epoll_event events[16];
+		int nbReady = epoll_wait(m_epoll, events, 16, IO_TIMEOUT_MS);
+		for (int i = 0; i < nbReady; i++)
+			drainSocket((OSCListener*)events[i].data.ptr);
+#else
+		fd_set readset;
+		FD_ZERO(&readset);
+		int maxHandle = -1;
+		for (unsigned int i = 0; i < oscListeners.size(); i++)
 		{
-			oscpkt::PacketReader pr;
-			pr.init(oscListeners[i]->sock.packetData(), oscListeners[i]->sock.packetSize());
-			
-			oscpkt::Message *msg;
-			if (pr.isOk() && (msg = pr.popMessage()) != 0)
-			{	
-				mr.text = msg->addressPattern();
-				mr.values.clear();
-
-				oscpkt::Message::ArgReader argRead(msg->arg());
-				if (argRead.isOk())
-				{
-					while (!argRead.isOkNoMoreArgs())
-					{
-						float farg;
-						argRead.popFloat(farg);
-						mr.values.push_back(farg);
-					}
-				}
-				if (verbose)
-				{
-					std::cout << "message received from " << oscListeners[i]->sock.packetOrigin() << std::endl;
-					std::cout << mr.text;
-					for (unsigned int k = 0; k < mr.values.size(); k++)
-						std::cout << " " << mr.values[k];
-					std::cout << std::endl;
-				}
+			int handle = oscListeners[i]->sock.socketHandle();
+			if (oscListeners[i]->sock.isOk() && handle != -1)
+			{
+				FD_SET(handle, &readset);
+				if (handle > maxHandle)
+					maxHandle = handle;
 			}
+		}
+		if (maxHandle == -1)
+			return;
+
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = IO_TIMEOUT_MS * 1000;
+		if (select(maxHandle + 1, &readset, 0, 0, &tv) <= 0)
+			continue;
 
+		for (unsigned int i = 0; i < oscListeners.size(); i++)
+		{
+			if (oscListeners[i]->sock.isOk() && FD_ISSET(oscListeners[i]->sock.socketHandle(), &readset))
+				drainSocket(oscListeners[i]);
 		}
+#endif
 	}
-	return mr;
 }
 
 
-void OSCReceiver::close(bool verbose)
+void OSCReceiver::drainSocket(OSCListener* listener)
 {
-	for (unsigned int i = 0; i < oscListeners.size(); i++)
+	// the socket is non blocking: read until nothing is left
+	while (true)
 	{
-		if (oscListeners[i]->sock.isOk())
-			oscListeners[i]->sock.close();
-		delete oscListeners[i];
+		oscpkt::SockAddr origin;
+		socklen_t len = (socklen_t)origin.maxLen();
+		int nread = (int)recvfrom(listener->sock.socketHandle(), &m_packet[0], (int)m_packet.size(), 0, &origin.addr(), &len);
+		if (nread <= 0)
+			return;
+
+		m_parsed.clear();
+		parsePacket(&m_packet[0], nread, m_parsed);
+		for (unsigned int i = 0; i < m_parsed.size(); i++)
+		{
+			if (m_verbose)
+				std::cout << "message received on port " << listener->port << " from " << origin << std::endl;
+			if (!m_messages.push(m_parsed[i]))
+				std::cerr << "OSC receive queue full, message " << m_parsed[i].text << " dropped" << std::endl;
+		}
 	}
 }
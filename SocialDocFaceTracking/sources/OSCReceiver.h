@@ -1,6 +1,10 @@
 #pragma once
 
 #include "OSCUtils.h"
+#include "RingBuffer.h"
+
+#include <thread>
+#include <atomic>
 
 struct OSCListener
 {
@@ -8,6 +12,11 @@ struct OSCListener
 	oscpkt::UdpSocket sock;
 };
 
+/**
+* \brief Listens to every OSC port on a dedicated I/O thread.
+*	Each time a socket is readable, all its pending packets are drained and every message
+*	they contain (bundles included) is queued, so the frame loop only pops messages and never blocks.
+*/
 class OSCReceiver
 {
 public:
@@ -15,11 +24,30 @@ public:
 	~OSCReceiver();
 
 	void init(std::vector<int> ports, bool verbose = true);
-	bool messageReceived(bool verbose = true);
-	OSCMessage getMessage(bool verbose = true);
+	// true if at least one message is waiting in the queue
+	bool messageReceived();
+	// pop the oldest received message, return false if there is none
+	bool getMessage(OSCMessage& mes, bool verbose = true);
 	void close(bool verbose = true);
 
+	// extract all the messages of a packet, recursing into bundles
+	static void parsePacket(const void* data, size_t size, std::vector<OSCMessage>& messages);
+
 private:
+	void receiveLoop();
+	void drainSocket(OSCListener* listener);
+
 	std::vector<OSCListener*> oscListeners;
-};
 
+	std::thread m_ioThread;
+	std::atomic<bool> m_running;
+	RingBuffer<OSCMessage> m_messages;
+	bool m_verbose;
+
+	// only used by the I/O thread
+	std::vector<char> m_packet;
+	std::vector<OSCMessage> m_parsed;
+#ifdef __linux__
+	int m_epoll;
+#endif
+};
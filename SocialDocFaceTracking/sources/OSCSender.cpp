@@ -1,7 +1,10 @@
 #include "OSCSender.h"
 
+#include <chrono>
 
-OSCSender::OSCSender()
+
+OSCSender::OSCSender() :
+m_inFrame(false), m_frameSize(0)
 {
 }
 
@@ -17,55 +20,103 @@ bool OSCSender::init(std::vector<std::pair<std::string, int>> clientsIP, bool ve
 
 	for (unsigned int i = 0; i<clientsIP.size(); i++)
 	{
-		oscClients.push_back(new OSCClient);
-		oscClients[i]->address = clientsIP[i].first;
-		oscClients[i]->port = clientsIP[i].second;
-		oscClients[i]->sock.connectTo(oscClients[i]->address, oscClients[i]->port);
-		oscClients[i]->connected = oscClients[i]->sock.isOk();
+		OSCClient* client = new OSCClient;
+		oscClients.push_back(client);
+		client->address = clientsIP[i].first;
+		client->port = clientsIP[i].second;
+		client->sock.connectTo(client->address, client->port);
+		client->connected = client->sock.isOk();
 
-		if (!oscClients[i]->connected)
+		if (!client->connected)
 		{
-			std::cerr << "Error connection to '" << oscClients[i]->address;
-			std::cerr << "' on port " << oscClients[i]->port << "\n";
+			std::cerr << "Error connection to '" << client->address;
+			std::cerr << "' on port " << client->port << "\n";
 		}
 		else
 		{
 			if (verbose)
-				std::cout << "Client started, will send packets to '" << oscClients[i]->address << "' on port " << oscClients[i]->port << std::endl;
+				std::cout << "Client started, will send packets to '" << client->address << "' on port " << client->port << std::endl;
 		}
-		success &= oscClients[i]->connected;
+		success &= client->connected;
 	}
 	return success;
 }
 
 
-void OSCSender::send(OSCMessage mes, bool verbose)
+void OSCSender::send(const OSCMessage& mes, bool verbose)
+{
+	send(mes.text, mes.values.empty() ? 0 : &mes.values[0], mes.values.size(), verbose);
+}
+
+
+void OSCSender::send(const std::string& address, const float* values, unsigned int nbValues, bool verbose)
+{
+	if (oscClients.empty())
+		return;
+
+	if (verbose)
+	{
+		std::cout << address;
+		for (unsigned int j = 0; j<nbValues; j++)
+			std::cout << " " << values[j];
+		std::cout << std::endl;
+	}
+
+	m_message.init(address);
+	for (unsigned int j = 0; j<nbValues; j++)
+		m_message.pushFloat(values[j]);
+
+	if (m_inFrame)
+	{
+		m_writer.addMessage(m_message);
+		m_frameSize++;
+	}
+	else
+	{
+		m_writer.init();
+		m_writer.startBundle();
+		m_writer.addMessage(m_message);
+		m_writer.endBundle();
+		sendPacket(m_writer, verbose);
+	}
+}
+
+
+void OSCSender::beginFrame()
+{
+	// timetag the bundle with the current time (NTP format: seconds since 1900 and 32 bits fraction)
+	double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+	uint64_t seconds = (uint64_t)now;
+	uint64_t fraction = (uint64_t)((now - (double)seconds) * 4294967296.0);
+	oscpkt::TimeTag timeTag(((seconds + 2208988800ULL) << 32) | fraction);
+
+	m_writer.init();
+	m_writer.startBundle(timeTag);
+	m_inFrame = true;
+	m_frameSize = 0;
+}
+
+
+void OSCSender::endFrame(bool verbose)
+{
+	if (!m_inFrame)
+		return;
+	m_inFrame = false;
+	m_writer.endBundle();
+	if (m_frameSize > 0)
+		sendPacket(m_writer, verbose);
+}
+
+
+void OSCSender::sendPacket(oscpkt::PacketWriter& pw, bool verbose)
 {
 	for (unsigned int i = 0; i < oscClients.size(); i++)
 	{
 		if (oscClients[i]->connected)
 		{
-			oscpkt::PacketWriter pw;
-			oscpkt::Message msg;
-
 			if (verbose)
-			{
-				std::cout << "send message to " << oscClients[i]->address << ":" << oscClients[i]->port << std::endl;
-				std::cout << mes.text;
-				for (unsigned int j = 0; j<mes.values.size(); j++)
-					std::cout << " " << mes.values[j];
-				std::cout << std::endl;
-			}
-			msg.init(mes.text);
-
-			for (unsigned int j = 0; j<mes.values.size(); j++)
-				msg.pushFloat(mes.values[j]);
-
-			pw.startBundle();
-			pw.addMessage(msg);
+				std::cout << "send packet to " << oscClients[i]->address << ":" << oscClients[i]->port << std::endl;
 			oscClients[i]->sock.sendPacket(pw.packetData(), pw.packetSize());
-			pw.endBundle();
-			msg.clear();
 		}
 	}
 }
@@ -83,4 +134,6 @@ void OSCSender::close(bool verbose)
 		}
 		delete oscClients[i];
 	}
+	// init can be called again, e.g. when the client list is reloaded
+	oscClients.clear();
 }
\ No newline at end of file
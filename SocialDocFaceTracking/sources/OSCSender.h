@@ -16,10 +16,26 @@ public:
 	OSCSender();
 	~OSCSender();
 	bool init(std::vector<std::pair<std::string, int>> clientsIP, bool verbose = true);
-	void send(OSCMessage mes, bool verbose = true);
+	// outside a frame, the message is sent right away in its own packet
+	void send(const OSCMessage& mes, bool verbose = true);
+	// same without building an OSCMessage, never allocates once the buffers have grown
+	void send(const std::string& address, const float* values, unsigned int nbValues, bool verbose = true);
 	void close(bool verbose = true);
 
+	// every message sent between beginFrame() and endFrame() is packed in a single
+	// timetagged bundle, sent once to each client when the frame ends
+	void beginFrame();
+	void endFrame(bool verbose = true);
+
 private:
+	void sendPacket(oscpkt::PacketWriter& pw, bool verbose);
+
 	std::vector<OSCClient*> oscClients;
+
+	// reused from one frame to the next, so they keep their capacity
+	oscpkt::PacketWriter m_writer;
+	oscpkt::Message m_message;
+	bool m_inFrame;
+	unsigned int m_frameSize;
 };
 
@@ -1,11 +1,11 @@
 #pragma once
 
-#include <oscpkt\oscpkt.hh>
-#include <oscpkt\udp.hh>
+#include <iostream>
+#include <oscpkt/oscpkt.hh>
+#include <oscpkt/udp.hh>
 
 #include <string>
 #include <vector>
-#include <iostream>
 
 struct OSCMessage
 {
@@ -0,0 +1,386 @@
+#include "ReplayTrackingSource.h"
+
+#include <cstring>
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace KISDRecord;
+
+// the recorder does not store the images, replay at the Kinect resolution
+static const int REPLAY_WIDTH = 640;
+static const int REPLAY_HEIGHT = 480;
+
+
+ReplayTrackingSource::ReplayTrackingSource(const std::string& path, bool realTime) :
+m_path(path), m_realTime(realTime),
+#ifdef _WIN32
+m_file(INVALID_HANDLE_VALUE), m_mapping(0),
+#else
+m_file(-1),
+#endif
+m_data(0), m_size(0), m_index(0), m_nbFrames(0), m_frame(0), m_finished(false),
+m_header(0), m_records(0), m_events(0), m_nextEvent(0)
+{
+	m_users.reserve(Fubi::MaxUsers);
+	m_previousUsers.reserve(Fubi::MaxUsers);
+}
+
+
+ReplayTrackingSource::~ReplayTrackingSource()
+{
+	unmapFile();
+}
+
+
+bool ReplayTrackingSource::init()
+{
+	if (!mapFile())
+		return false;
+
+	if (m_size < sizeof(RecordFileHeader))
+	{
+		std::cerr << m_path << " is not a session record" << std::endl;
+		return false;
+	}
+	const RecordFileHeader* header = (const RecordFileHeader*)m_data;
+	if (strncmp(header->magic, "KISDREC", 8) != 0 || header->version != VERSION
+		|| header->userSize != sizeof(RecordUser) || header->eventSize != sizeof(RecordEvent))
+	{
+		std::cerr << m_path << " is not a session record or was written by another version" << std::endl;
+		return false;
+	}
+
+	if (!readIndex())
+		return false;
+
+	m_frame = 0;
+	m_finished = m_nbFrames == 0;
+	m_header = 0;
+	m_users.clear();
+	m_startClock = std::chrono::steady_clock::now();
+	std::cout << "Replaying " << m_nbFrames << " frames from " << m_path << std::endl;
+	return true;
+}
+
+
+bool ReplayTrackingSource::mapFile()
+{
+	unmapFile();
+#ifdef _WIN32
+	m_file = CreateFileA(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "Cannot open record file " << m_path << std::endl;
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(m_file, &size);
+	m_size = (size_t)size.QuadPart;
+	if (m_size == 0)
+		return true;
+	m_mapping = CreateFileMappingA(m_file, 0, PAGE_READONLY, 0, 0, 0);
+	if (m_mapping)
+		m_data = (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	m_file = open(m_path.c_str(), O_RDONLY);
+	if (m_file < 0)
+	{
+		std::cerr << "Cannot open record file " << m_path << std::endl;
+		return false;
+	}
+	struct stat st;
+	fstat(m_file, &st);
+	m_size = (size_t)st.st_size;
+	if (m_size == 0)
+		return true;
+	void* data = mmap(0, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data != MAP_FAILED)
+	{
+		m_data = (const char*)data;
+		// the frames are read once, in order
+		madvise(data, m_size, MADV_SEQUENTIAL);
+	}
+#endif
+	if (!m_data)
+	{
+		std::cerr << "Cannot map record file " << m_path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+void ReplayTrackingSource::unmapFile()
+{
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_mapping = 0;
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if (m_data)
+		munmap((void*)m_data, m_size);
+	if (m_file >= 0)
+		::close(m_file);
+	m_file = -1;
+#endif
+	m_data = 0;
+	m_size = 0;
+	m_index = 0;
+	m_nbFrames = 0;
+}
+
+
+bool ReplayTrackingSource::isValidFrame(uint64_t offset, uint64_t end) const
+{
+	if (offset < sizeof(RecordFileHeader) || offset > end || end - offset < sizeof(RecordFrameHeader))
+		return false;
+	const RecordFrameHeader* header = (const RecordFrameHeader*)(m_data + offset);
+	return header->nbUsers <= Fubi::MaxUsers
+		&& header->size == sizeof(RecordFrameHeader) + header->nbUsers * sizeof(RecordUser) + header->nbEvents * sizeof(RecordEvent)
+		&& header->size <= end - offset;
+}
+
+
+bool ReplayTrackingSource::readIndex()
+{
+	m_scannedIndex.clear();
+	if (m_size >= sizeof(RecordFileHeader) + sizeof(RecordFileFooter))
+	{
+		const RecordFileFooter* footer = (const RecordFileFooter*)(m_data + m_size - sizeof(RecordFileFooter));
+		if (memcmp(footer->magic, "KIDX", 4) == 0 && footer->indexOffset >= sizeof(RecordFileHeader)
+			&& footer->indexOffset + (uint64_t)footer->nbFrames * sizeof(uint64_t) + sizeof(RecordFileFooter) == m_size)
+		{
+			// every frame has to lie before the index, a corrupt index rejects the file
+			const uint64_t* index = (const uint64_t*)(m_data + footer->indexOffset);
+			for (uint32_t i = 0; i < footer->nbFrames; i++)
+			{
+				if (!isValidFrame(index[i], footer->indexOffset))
+				{
+					std::cerr << m_path << " is corrupt: frame " << i << " does not match its index" << std::endl;
+					return false;
+				}
+			}
+			m_index = index;
+			m_nbFrames = footer->nbFrames;
+			return true;
+		}
+	}
+
+	// no index, the recording was interrupted: walk the frames
+	std::cout << m_path << " has no index, scanning the frames" << std::endl;
+	uint64_t offset = sizeof(RecordFileHeader);
+	// up to the first incomplete frame, the one being written when the recording stopped
+	while (isValidFrame(offset, m_size))
+	{
+		m_scannedIndex.push_back(offset);
+		offset += ((const RecordFrameHeader*)(m_data + offset))->size;
+	}
+	m_index = m_scannedIndex.empty() ? 0 : &m_scannedIndex[0];
+	m_nbFrames = m_scannedIndex.size();
+	return true;
+}
+
+
+void ReplayTrackingSource::update()
+{
+	if (m_frame >= m_nbFrames)
+	{
+		m_finished = true;
+		return;
+	}
+
+	m_header = (const RecordFrameHeader*)(m_data + m_index[m_frame++]);
+	m_records = (const RecordUser*)(m_header + 1);
+	m_events = (const RecordEvent*)(m_records + m_header->nbUsers);
+	m_nextEvent = 0;
+
+	if (m_realTime)
+	{
+		const RecordFrameHeader* first = (const RecordFrameHeader*)(m_data + m_index[0]);
+		std::chrono::steady_clock::time_point due = m_startClock
+			+ std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_header->timeStamp - first->timeStamp));
+		std::this_thread::sleep_until(due);
+	}
+
+	// users of this frame, the interest state is kept while they stay in the scene
+	m_previousUsers.swap(m_users);
+	m_users.clear();
+	for (unsigned int i = 0; i < m_header->nbUsers; i++)
+	{
+		const RecordUser& rec = m_records[i];
+		m_users.push_back(TrackedUser());
+		TrackedUser& user = m_users.back();
+		unsigned int previous = 0;
+		while (previous < m_previousUsers.size() && m_previousUsers[previous].m_id != rec.id)
+			previous++;
+		if (previous < m_previousUsers.size())
+			user = m_previousUsers[previous];
+		else
+			user.m_interestBegTime = m_header->timeStamp;
+
+		user.m_id = rec.id;
+		user.m_isTracked = rec.isTracked != 0;
+		user.m_isFaceTracked = rec.isFaceTracked != 0;
+		user.m_faceRectCv = cv::Rect(rec.faceRect[0], rec.faceRect[1], rec.faceRect[2], rec.faceRect[3]);
+		user.m_torsoPosition = Fubi::Vec3f(rec.torso[0], rec.torso[1], rec.torso[2]);
+		user.m_torsoConfidence = rec.torsoConfidence;
+		for (int j = 0; j < Fubi::BodyMeasurement::NUM_MEASUREMENTS; j++)
+			user.m_bodyMeasurements[j] = Fubi::BodyMeasurementDistance(rec.bodyMeasurements[j][0], rec.bodyMeasurements[j][1]);
+	}
+}
+
+
+double ReplayTrackingSource::getCurrentTime()
+{
+	if (m_header)
+		return m_header->timeStamp;
+	if (m_nbFrames > 0)
+		return ((const RecordFrameHeader*)(m_data + m_index[0]))->timeStamp;
+	return 0.0;
+}
+
+
+void ReplayTrackingSource::getRgbResolution(int& width, int& height)
+{
+	width = REPLAY_WIDTH;
+	height = REPLAY_HEIGHT;
+}
+
+
+bool ReplayTrackingSource::getImage(unsigned char* buffer, int renderOptions)
+{
+	if (!buffer)
+		return false;
+	cv::Mat image(REPLAY_HEIGHT, REPLAY_WIDTH, CV_8UC3, buffer);
+	image.setTo(cv::Scalar(0, 0, 0));
+	if (m_header && (renderOptions & Fubi::RenderOptions::Shapes))
+	{
+		for (unsigned int i = 0; i < m_header->nbUsers; i++)
+		{
+			const RecordUser& rec = m_records[i];
+			if (rec.isFaceTracked)
+				cv::rectangle(image, cv::Rect(rec.faceRect[0], rec.faceRect[1], rec.faceRect[2], rec.faceRect[3]), cv::Scalar(0, 255, 0));
+		}
+	}
+	return true;
+}
+
+
+std::deque<unsigned int> ReplayTrackingSource::getClosestUserIDs()
+{
+	// users are recorded from the closest to the farthest
+	std::deque<unsigned int> ids;
+	if (m_header)
+	{
+		for (unsigned int i = 0; i < m_header->nbUsers; i++)
+			ids.push_back(m_records[i].id);
+	}
+	return ids;
+}
+
+
+unsigned int ReplayTrackingSource::fillClosestUserIDs(unsigned int* ids, unsigned int maxUsers)
+{
+	if (!m_header)
+		return 0;
+	unsigned int count = std::min<unsigned int>(m_header->nbUsers, maxUsers);
+	for (unsigned int i = 0; i < count; i++)
+		ids[i] = m_records[i].id;
+	return count;
+}
+
+
+TrackedUser* ReplayTrackingSource::getUser(unsigned int userID)
+{
+	for (unsigned int i = 0; i < m_users.size(); i++)
+	{
+		if (m_users[i].m_id == userID)
+			return &m_users[i];
+	}
+	return 0;
+}
+
+
+const RecordUser* ReplayTrackingSource::findRecord(unsigned int userID)
+{
+	if (!m_header)
+		return 0;
+	for (unsigned int i = 0; i < m_header->nbUsers; i++)
+	{
+		if (m_records[i].id == userID)
+			return &m_records[i];
+	}
+	return 0;
+}
+
+
+Fubi::Vec3f ReplayTrackingSource::getUserHeadCenter(unsigned int userID)
+{
+	const RecordUser* rec = findRecord(userID);
+	if (!rec)
+		return Fubi::Vec3f(0, 0, 0);
+	return Fubi::Vec3f(rec->headCenter[0], rec->headCenter[1], rec->headCenter[2]);
+}
+
+
+Fubi::Vec3f ReplayTrackingSource::getUserHeadRotation(unsigned int userID)
+{
+	const RecordUser* rec = findRecord(userID);
+	if (!rec)
+		return Fubi::Vec3f(0, 0, 0);
+	return Fubi::Vec3f(rec->headRotation[0], rec->headRotation[1], rec->headRotation[2]);
+}
+
+
+std::string ReplayTrackingSource::getUserName(unsigned int userID)
+{
+	std::ostringstream oss;
+	oss << "User " << userID;
+	return oss.str();
+}
+
+
+void ReplayTrackingSource::updateUserScreenWatched(unsigned int userID, int screen)
+{
+	TrackedUser* user = getUser(userID);
+	if (user)
+		user->updateScreenWatched(screen, getCurrentTime());
+}
+
+
+void ReplayTrackingSource::resetUserInterest(unsigned int userID)
+{
+	TrackedUser* user = getUser(userID);
+	if (user)
+	{
+		user->m_interestBegTime = getCurrentTime();
+		user->m_interestTime = 0.0;
+	}
+}
+
+
+bool ReplayTrackingSource::popEvent(OSCMessage& mes)
+{
+	if (!m_header || m_nextEvent >= m_header->nbEvents)
+		return false;
+
+	const RecordEvent& event = m_events[m_nextEvent++];
+	mes.text.assign(event.address, strnlen(event.address, sizeof(event.address)));
+	// a corrupt count cannot read past the event
+	mes.values.assign(event.values, event.values + std::min<uint32_t>(event.nbValues, MAX_EVENT_VALUES));
+	return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "TrackingSource.h"
+#include "SessionRecorder.h"
+
+#include <vector>
+#include <chrono>
+
+/**
+* \brief Plays back a session recorded with the SessionRecorder (-record option).
+*	The file is memory-mapped and the frames are read in place, the rgb image is a black
+*	frame on which the recorded face rectangles are drawn.
+*/
+class ReplayTrackingSource : public ITrackingSource
+{
+public:
+	// realTime: wait between the frames as during the recording, else replay as fast as possible
+	ReplayTrackingSource(const std::string& path, bool realTime = true);
+	~ReplayTrackingSource();
+
+	bool init();
+	void update();
+	double getCurrentTime();
+	bool isFinished() { return m_finished; };
+	unsigned int getNbFrames() { return (unsigned int)m_nbFrames; };
+
+	void getRgbResolution(int& width, int& height);
+	bool getImage(unsigned char* buffer, int renderOptions);
+
+	std::deque<unsigned int> getClosestUserIDs();
+	unsigned int fillClosestUserIDs(unsigned int* ids, unsigned int maxUsers);
+	TrackedUser* getUser(unsigned int userID);
+	Fubi::Vec3f getUserHeadCenter(unsigned int userID);
+	Fubi::Vec3f getUserHeadRotation(unsigned int userID);
+	std::string getUserName(unsigned int userID);
+	void updateUserScreenWatched(unsigned int userID, int screen);
+	void resetUserInterest(unsigned int userID);
+
+	bool popEvent(OSCMessage& mes);
+
+private:
+	bool mapFile();
+	void unmapFile();
+	// find the frames, from the index at the end of the file or by walking them
+	bool readIndex();
+	// frame record complete between offset and end, its users and events included
+	bool isValidFrame(uint64_t offset, uint64_t end) const;
+	const KISDRecord::RecordUser* findRecord(unsigned int userID);
+
+	std::string m_path;
+	bool m_realTime;
+
+#ifdef _WIN32
+	void* m_file;		// HANDLE
+	void* m_mapping;	// HANDLE
+#else
+	int m_file;
+#endif
+	const char* m_data;
+	size_t m_size;
+
+	const uint64_t* m_index;
+	std::vector<uint64_t> m_scannedIndex;	// only used if the file has no index
+	size_t m_nbFrames;
+
+	// current frame
+	size_t m_frame;
+	bool m_finished;
+	const KISDRecord::RecordFrameHeader* m_header;
+	const KISDRecord::RecordUser* m_records;
+	const KISDRecord::RecordEvent* m_events;
+	unsigned int m_nextEvent;
+
+	// users of the current and previous frames, MaxUsers reserved so that a frame does not allocate
+	std::vector<TrackedUser> m_users;
+	std::vector<TrackedUser> m_previousUsers;
+	std::chrono::steady_clock::time_point m_startClock;
+};
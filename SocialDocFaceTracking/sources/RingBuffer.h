@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+/**
+* \brief Bounded lock-free queue between exactly one producer thread and one consumer thread.
+*	push() never blocks: when the ring is full it returns false and the item is dropped,
+*	so a slow consumer loses items instead of adding latency to the producer.
+*/
+template <typename T>
+class RingBuffer
+{
+public:
+	// the capacity is rounded up to the next power of two
+	explicit RingBuffer(size_t capacity = 4) : m_head(0), m_tail(0)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+		m_items.resize(size);
+		m_mask = size - 1;
+	}
+
+	// producer side
+	bool push(const T& item)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+			return false; // full
+		m_items[tail & m_mask] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side
+	bool pop(T& item)
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+			return false; // empty
+		item = m_items[head & m_mask];
+		m_items[head & m_mask] = T(); // release any resource held by the slot
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side: keep only the most recent item
+	bool popLatest(T& item)
+	{
+		bool found = false;
+		while (pop(item))
+			found = true;
+		return found;
+	}
+
+	bool empty() const { return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire); }
+	size_t capacity() const { return m_mask + 1; }
+
+private:
+	RingBuffer(const RingBuffer&);
+	RingBuffer& operator=(const RingBuffer&);
+
+	std::vector<T> m_items;
+	size_t m_mask;
+	// head and tail live on separate cache lines to avoid false sharing between both threads
+	std::atomic<size_t> m_head;
+	char m_padding[64];
+	std::atomic<size_t> m_tail;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+
+/**
+* \brief Latest value published by one writer thread, read by any number of threads without lock.
+*	The writer never waits: a reader that overlapped a write sees the sequence change and copies
+*	the value again. The value is kept in atomic words, so that the copy itself is not a data race.
+*/
+template <typename T>
+class SeqLock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock values are copied word by word");
+
+public:
+	SeqLock() : m_sequence(0)
+	{
+		publishWords(T());
+		m_sequence = 0;
+	}
+
+	// writer side, one thread only
+	void publish(const T& value)
+	{
+		publishWords(value);
+	}
+
+	// number of values published, the sequence is odd during a write
+	uint64_t getVersion() const { return m_sequence.load(std::memory_order_acquire) / 2; };
+
+	// false if a write overlapped the copy, value is then partial
+	bool tryRead(T& value) const
+	{
+		uint64_t before = m_sequence.load(std::memory_order_acquire);
+		if (before & 1)
+			return false;
+		uint64_t words[NB_WORDS];
+		for (size_t i = 0; i < NB_WORDS; i++)
+			words[i] = m_words[i].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (m_sequence.load(std::memory_order_relaxed) != before)
+			return false;
+		memcpy(&value, words, sizeof(T));
+		return true;
+	}
+
+	// retries until a consistent value is read, a write takes well under a microsecond
+	void read(T& value) const
+	{
+		while (!tryRead(value))
+			std::this_thread::yield();
+	}
+
+private:
+	static const size_t NB_WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	void publishWords(const T& value)
+	{
+		uint64_t words[NB_WORDS] = { 0 };
+		memcpy(words, &value, sizeof(T));
+		uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+		m_sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (size_t i = 0; i < NB_WORDS; i++)
+			m_words[i].store(words[i], std::memory_order_relaxed);
+		m_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	std::atomic<uint64_t> m_sequence;
+	std::atomic<uint64_t> m_words[NB_WORDS];
+};
@@ -0,0 +1,196 @@
+#include "SessionRecorder.h"
+
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+
+using namespace KISDRecord;
+
+// records are read in place from memory-mapped files
+static_assert(sizeof(RecordFileHeader) % 8 == 0 && sizeof(RecordFrameHeader) % 8 == 0 && sizeof(RecordUser) % 8 == 0
+	&& sizeof(RecordEvent) % 8 == 0 && sizeof(RecordFileFooter) % 8 == 0, "record sizes must be multiples of 8 bytes");
+
+SessionRecorder::SessionRecorder() :
+m_file(0), m_running(false), m_frames(128), m_inFrame(false), m_frameNumber(0), m_dropped(0), m_droppedEvents(0), m_position(0)
+{
+	memset(&m_current, 0, sizeof(m_current));
+}
+
+
+SessionRecorder::~SessionRecorder()
+{
+	close();
+}
+
+
+bool SessionRecorder::open(const std::string& path)
+{
+	close();
+	m_file = fopen(path.c_str(), "wb");
+	if (!m_file)
+	{
+		std::cerr << "Cannot open record file " << path << std::endl;
+		return false;
+	}
+	// large buffer, the writer thread flushes in big chunks
+	setvbuf(m_file, 0, _IOFBF, 1 << 20);
+
+	RecordFileHeader header;
+	memset(&header, 0, sizeof(header));
+	strcpy(header.magic, "KISDREC");
+	header.version = VERSION;
+	header.userSize = sizeof(RecordUser);
+	header.eventSize = sizeof(RecordEvent);
+	fwrite(&header, sizeof(header), 1, m_file);
+	m_position = sizeof(header);
+
+	m_offsets.clear();
+	m_offsets.reserve(30 * 3600 * 12); // a whole day at 30 fps
+	m_frameNumber = 0;
+	m_dropped = 0;
+	m_droppedEvents = 0;
+
+	m_running = true;
+	m_writer = std::thread(&SessionRecorder::writeLoop, this);
+	std::cout << "Recording session to " << path << std::endl;
+	return true;
+}
+
+
+void SessionRecorder::close()
+{
+	if (!m_file)
+		return;
+
+	// let the writer empty the queue
+	m_running = false;
+	if (m_writer.joinable())
+		m_writer.join();
+
+	RecordFileFooter footer;
+	memset(&footer, 0, sizeof(footer));
+	footer.indexOffset = m_position;
+	footer.nbFrames = (uint32_t)m_offsets.size();
+	memcpy(footer.magic, "KIDX", 4);
+	if (!m_offsets.empty())
+		fwrite(&m_offsets[0], sizeof(uint64_t), m_offsets.size(), m_file);
+	fwrite(&footer, sizeof(footer), 1, m_file);
+	fclose(m_file);
+	m_file = 0;
+
+	std::cout << "Recording closed: " << footer.nbFrames << " frames";
+	if (m_dropped > 0)
+		std::cout << ", " << m_dropped << " frames dropped";
+	if (m_droppedEvents > 0)
+		std::cout << ", " << m_droppedEvents << " events dropped (more than " << MAX_EVENTS_PER_FRAME << " in a frame)";
+	std::cout << std::endl;
+}
+
+
+void SessionRecorder::beginFrame(double timeStamp)
+{
+	if (!m_file)
+		return;
+	m_current.header.frameNumber = m_frameNumber++;
+	m_current.header.timeStamp = timeStamp;
+	m_current.header.nbUsers = 0;
+	m_current.header.nbEvents = 0;
+	m_inFrame = true;
+}
+
+
+void SessionRecorder::recordEvent(const OSCMessage& mes)
+{
+	if (!m_inFrame)
+		return;
+	if (m_current.header.nbEvents >= MAX_EVENTS_PER_FRAME)
+	{
+		m_droppedEvents++;
+		return;
+	}
+
+	RecordEvent& event = m_current.events[m_current.header.nbEvents++];
+	memset(&event, 0, sizeof(event));
+	strncpy(event.address, mes.text.c_str(), sizeof(event.address) - 1);
+	event.nbValues = (uint32_t)std::min<size_t>(mes.values.size(), MAX_EVENT_VALUES);
+	for (uint32_t i = 0; i < event.nbValues; i++)
+		event.values[i] = mes.values[i];
+}
+
+
+void SessionRecorder::recordUser(const UserSnapshot& snapshot, unsigned int index)
+{
+	if (!m_inFrame || m_current.header.nbUsers >= Fubi::MaxUsers)
+		return;
+
+	const TrackedUser& user = *snapshot.users[index];
+	RecordUser& rec = m_current.users[m_current.header.nbUsers++];
+	memset(&rec, 0, sizeof(rec));
+	rec.id = user.m_id;
+	rec.isTracked = user.m_isTracked ? 1 : 0;
+	rec.isFaceTracked = user.m_isFaceTracked ? 1 : 0;
+
+	// the head is only read by the manager for face tracked users
+	if (user.m_isFaceTracked)
+	{
+		const Fubi::Vec3f& headCenter = snapshot.headCenters[index];
+		const Fubi::Vec3f& headRotation = snapshot.headRotations[index];
+		rec.headCenter[0] = headCenter.x;
+		rec.headCenter[1] = headCenter.y;
+		rec.headCenter[2] = headCenter.z;
+		rec.headRotation[0] = headRotation.x;
+		rec.headRotation[1] = headRotation.y;
+		rec.headRotation[2] = headRotation.z;
+	}
+
+	rec.faceRect[0] = user.m_faceRectCv.x;
+	rec.faceRect[1] = user.m_faceRectCv.y;
+	rec.faceRect[2] = user.m_faceRectCv.width;
+	rec.faceRect[3] = user.m_faceRectCv.height;
+
+	rec.torso[0] = user.m_torsoPosition.x;
+	rec.torso[1] = user.m_torsoPosition.y;
+	rec.torso[2] = user.m_torsoPosition.z;
+	rec.torsoConfidence = user.m_torsoConfidence;
+
+	for (int i = 0; i < Fubi::BodyMeasurement::NUM_MEASUREMENTS; i++)
+	{
+		rec.bodyMeasurements[i][0] = user.m_bodyMeasurements[i].m_dist;
+		rec.bodyMeasurements[i][1] = user.m_bodyMeasurements[i].m_confidence;
+	}
+}
+
+
+void SessionRecorder::endFrame()
+{
+	if (!m_inFrame)
+		return;
+	m_inFrame = false;
+	m_current.header.size = (uint32_t)(sizeof(RecordFrameHeader)
+		+ m_current.header.nbUsers * sizeof(RecordUser)
+		+ m_current.header.nbEvents * sizeof(RecordEvent));
+	if (!m_frames.push(m_current))
+		m_dropped++;
+}
+
+
+void SessionRecorder::writeLoop()
+{
+	RecordFrame frame;
+	while (true)
+	{
+		if (!m_frames.pop(frame))
+		{
+			if (!m_running)
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			continue;
+		}
+		m_offsets.push_back(m_position);
+		fwrite(&frame.header, sizeof(RecordFrameHeader), 1, m_file);
+		fwrite(frame.users, sizeof(RecordUser), frame.header.nbUsers, m_file);
+		fwrite(frame.events, sizeof(RecordEvent), frame.header.nbEvents, m_file);
+		m_position += frame.header.size;
+	}
+	fflush(m_file);
+}
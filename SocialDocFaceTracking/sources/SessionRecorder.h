@@ -0,0 +1,132 @@
+#pragma once
+
+#include <Fubi/FubiUtils.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <stdint.h>
+
+#include "OSCUtils.h"
+#include "RingBuffer.h"
+#include "UserSnapshot.h"
+
+/**
+* \file SessionRecorder.h
+* \brief Binary log of the tracking data read by UserManager::update, for offline replay.
+*
+* Layout (native little endian, every record size is a multiple of 8 bytes so that a
+* memory-mapped file can be read in place):
+*	RecordFileHeader
+*	for each frame: RecordFrameHeader, RecordUser[nbUsers] (closest first), RecordEvent[nbEvents]
+*	uint64_t frameOffsets[nbFrames]
+*	RecordFileFooter
+* The file is only ever appended to. If the footer is missing (crash), the frames can
+* still be walked from the first one thanks to RecordFrameHeader::size.
+*/
+
+namespace KISDRecord
+{
+	const uint32_t VERSION = 1;
+	const int MAX_EVENTS_PER_FRAME = 8;
+	const int MAX_EVENT_VALUES = 16;
+
+	struct RecordFileHeader
+	{
+		char magic[8];			// "KISDREC"
+		uint32_t version;
+		uint32_t userSize;		// sizeof(RecordUser)
+		uint32_t eventSize;		// sizeof(RecordEvent)
+		uint32_t reserved;
+	};
+
+	struct RecordFrameHeader
+	{
+		uint32_t size;			// size of the whole frame record, this header included
+		uint32_t frameNumber;
+		double timeStamp;		// seconds
+		uint16_t nbUsers;
+		uint16_t nbEvents;
+		uint32_t reserved;
+	};
+
+	struct RecordUser
+	{
+		uint32_t id;
+		uint8_t isTracked;
+		uint8_t isFaceTracked;
+		uint8_t reserved[2];
+		float headCenter[3];	// mm, only valid if isFaceTracked
+		float headRotation[3];	// degrees (pitch, yaw, roll), only valid if isFaceTracked
+		int32_t faceRect[4];	// x, y, width, height in the rgb image
+		float torso[3];			// mm
+		float torsoConfidence;
+		float bodyMeasurements[Fubi::BodyMeasurement::NUM_MEASUREMENTS][2];	// distance, confidence
+	};
+
+	// OSC message received during the frame
+	struct RecordEvent
+	{
+		char address[44];
+		uint32_t nbValues;
+		float values[MAX_EVENT_VALUES];
+	};
+
+	struct RecordFileFooter
+	{
+		uint64_t indexOffset;	// position of frameOffsets
+		uint32_t nbFrames;
+		char magic[4];			// "KIDX"
+	};
+
+	// one frame as queued between the tracking thread and the writer
+	struct RecordFrame
+	{
+		RecordFrameHeader header;
+		RecordUser users[Fubi::MaxUsers];
+		RecordEvent events[MAX_EVENTS_PER_FRAME];
+	};
+}
+
+/**
+* \brief Records every frame to a KISDRecord file.
+*	The tracking thread only fills a preallocated frame and pushes it to a ring buffer,
+*	all the file writing is done by a background thread.
+*/
+class SessionRecorder
+{
+public:
+	SessionRecorder();
+	~SessionRecorder();
+
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return m_file != 0; };
+
+	// called by the tracking thread, in this order, once per frame
+	void beginFrame(double timeStamp);
+	void recordEvent(const OSCMessage& mes);
+	void recordUser(const UserSnapshot& snapshot, unsigned int index);
+	void endFrame();
+
+private:
+	void writeLoop();
+
+	FILE* m_file;
+	std::thread m_writer;
+	std::atomic<bool> m_running;
+	RingBuffer<KISDRecord::RecordFrame> m_frames;
+
+	// frame being filled by the tracking thread
+	KISDRecord::RecordFrame m_current;
+	bool m_inFrame;
+	uint32_t m_frameNumber;
+	unsigned int m_dropped;
+	unsigned int m_droppedEvents;	// beyond MAX_EVENTS_PER_FRAME
+
+	// only used by the writer thread
+	std::vector<uint64_t> m_offsets;
+	uint64_t m_position;
+};
@@ -0,0 +1,238 @@
+#include "SyntheticTrackingSource.h"
+
+#include <cmath>
+#include <algorithm>
+#include <thread>
+
+// Kinect v1 color camera
+static const int SYNTHETIC_WIDTH = 640;
+static const int SYNTHETIC_HEIGHT = 480;
+static const float FOCAL_LENGTH = 525.0f;
+static const float RAD_TO_DEG = 57.2957795f;
+
+// area covered by the sensor (mm)
+static const float MIN_X = -1800.0f, MAX_X = 1800.0f;
+static const float MIN_Z = 800.0f, MAX_Z = 4500.0f;
+// beyond this distance the face tracker gives up
+static const float MAX_FACE_DISTANCE = 3500.0f;
+static const float MAX_FACE_YAW = 50.0f;
+
+
+SyntheticTrackingSource::SyntheticTrackingSource(unsigned int nbUsers, unsigned int seed, bool realTime, double frameRate) :
+m_nbUsers(std::min<unsigned int>(nbUsers, Fubi::MaxUsers)), m_seed(seed), m_state(1), m_realTime(realTime),
+m_frameTime(1.0 / frameRate), m_time(0)
+{
+}
+
+
+SyntheticTrackingSource::~SyntheticTrackingSource()
+{
+}
+
+
+bool SyntheticTrackingSource::init()
+{
+	// xorshift32 must not start from 0
+	m_state = m_seed * 2654435761u;
+	if (m_state == 0)
+		m_state = 1;
+	m_time = 0;
+	m_closestIDs.clear();
+
+	m_walkers.resize(m_nbUsers);
+	for (unsigned int i = 0; i < m_nbUsers; i++)
+	{
+		Walker& walker = m_walkers[i];
+		walker.user = TrackedUser();
+		walker.user.m_id = i + 1;
+		walker.user.m_isTracked = true;
+		walker.user.m_torsoPosition = Fubi::Vec3f(random(MIN_X, MAX_X), random(-150.0f, 150.0f), random(MIN_Z, MAX_Z));
+		walker.user.m_torsoConfidence = 1.0f;
+		// adults and children, used for the age estimation
+		walker.user.m_bodyMeasurements[Fubi::BodyMeasurement::SHOULDER_WIDTH] = Fubi::BodyMeasurementDistance(random(250.0f, 450.0f), 1.0f);
+		decide(walker);
+	}
+	m_startClock = std::chrono::steady_clock::now();
+	return true;
+}
+
+
+float SyntheticTrackingSource::random(float min, float max)
+{
+	m_state ^= m_state << 13;
+	m_state ^= m_state >> 17;
+	m_state ^= m_state << 5;
+	return min + (max - min) * (float)((m_state >> 8) * (1.0 / 16777216.0));
+}
+
+
+void SyntheticTrackingSource::decide(Walker& walker)
+{
+	walker.nextDecision = m_time + random(1.0f, 5.0f);
+
+	// half of the users stand still
+	if (random(0.0f, 1.0f) < 0.5f)
+		walker.velocity = Fubi::Vec3f(0, 0, 0);
+	else
+	{
+		float direction = random(0.0f, 6.2831853f);
+		float speed = random(300.0f, 1200.0f);
+		walker.velocity = Fubi::Vec3f(speed * std::cos(direction), 0, speed * std::sin(direction));
+	}
+
+	// mostly look at the screens, above the sensor
+	if (random(0.0f, 1.0f) < 0.75f)
+		walker.target = Fubi::Vec3f(random(-800.0f, 800.0f), random(0.0f, 900.0f), 0.0f);
+	else
+	{
+		float side = (random(0.0f, 1.0f) < 0.5f) ? -1.0f : 1.0f;
+		walker.target = Fubi::Vec3f(side * random(2500.0f, 4000.0f), random(-300.0f, 800.0f), random(0.0f, 3000.0f));
+	}
+}
+
+
+void SyntheticTrackingSource::update()
+{
+	m_time += m_frameTime;
+	if (m_realTime)
+		std::this_thread::sleep_until(m_startClock + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(m_time)));
+
+	// kept from frame to frame, so that the benchmarks only measure the manager
+	std::vector<std::pair<float, unsigned int> >& distances = m_distances;
+	distances.clear();
+	for (unsigned int i = 0; i < m_walkers.size(); i++)
+	{
+		Walker& walker = m_walkers[i];
+		if (m_time >= walker.nextDecision)
+			decide(walker);
+
+		// walk, bouncing on the limits of the tracking area
+		Fubi::Vec3f& torso = walker.user.m_torsoPosition;
+		torso += walker.velocity * (float)m_frameTime;
+		if (torso.x < MIN_X || torso.x > MAX_X)
+		{
+			walker.velocity.x = -walker.velocity.x;
+			torso.x = std::max(MIN_X, std::min(MAX_X, torso.x));
+		}
+		if (torso.z < MIN_Z || torso.z > MAX_Z)
+		{
+			walker.velocity.z = -walker.velocity.z;
+			torso.z = std::max(MIN_Z, std::min(MAX_Z, torso.z));
+		}
+
+		// look at the target, with some noise
+		walker.headCenter = torso + Fubi::Vec3f(0, 450.0f, 0);
+		Fubi::Vec3f gaze = walker.target - walker.headCenter;
+		float horizontal = std::sqrt(gaze.x * gaze.x + gaze.z * gaze.z);
+		walker.headRotation.x = std::atan2(gaze.y, horizontal) * RAD_TO_DEG + random(-2.0f, 2.0f);
+		walker.headRotation.y = std::atan2(-gaze.x, -gaze.z) * RAD_TO_DEG + random(-2.0f, 2.0f);
+		walker.headRotation.z = random(-5.0f, 5.0f);
+
+		// face projected in the rgb image, the face tracker only works for close users facing the sensor
+		const Fubi::Vec3f& head = walker.headCenter;
+		float size = FOCAL_LENGTH * 200.0f / head.z;
+		cv::Rect faceRect((int)(SYNTHETIC_WIDTH / 2 + FOCAL_LENGTH * head.x / head.z - size / 2),
+			(int)(SYNTHETIC_HEIGHT / 2 - FOCAL_LENGTH * head.y / head.z - size / 2), (int)size, (int)size);
+		walker.user.m_faceRectCv = faceRect;
+		walker.user.m_isFaceTracked = head.z < MAX_FACE_DISTANCE && std::fabs(walker.headRotation.y) < MAX_FACE_YAW
+			&& faceRect.x >= 0 && faceRect.y >= 0
+			&& faceRect.x + faceRect.width <= SYNTHETIC_WIDTH && faceRect.y + faceRect.height <= SYNTHETIC_HEIGHT;
+
+		distances.push_back(std::pair<float, unsigned int>(torso.z, walker.user.m_id));
+	}
+
+	std::sort(distances.begin(), distances.end());
+	m_closestIDs.clear();
+	for (unsigned int i = 0; i < distances.size(); i++)
+		m_closestIDs.push_back(distances[i].second);
+}
+
+
+void SyntheticTrackingSource::getRgbResolution(int& width, int& height)
+{
+	width = SYNTHETIC_WIDTH;
+	height = SYNTHETIC_HEIGHT;
+}
+
+
+bool SyntheticTrackingSource::getImage(unsigned char* buffer, int renderOptions)
+{
+	if (!buffer)
+		return false;
+	cv::Mat image(SYNTHETIC_HEIGHT, SYNTHETIC_WIDTH, CV_8UC3, buffer);
+	image.setTo(cv::Scalar(0, 0, 0));
+	if (renderOptions & Fubi::RenderOptions::Shapes)
+	{
+		for (unsigned int i = 0; i < m_walkers.size(); i++)
+		{
+			if (m_walkers[i].user.m_isFaceTracked)
+				cv::rectangle(image, m_walkers[i].user.m_faceRectCv, cv::Scalar(0, 255, 0));
+		}
+	}
+	return true;
+}
+
+
+SyntheticTrackingSource::Walker* SyntheticTrackingSource::findWalker(unsigned int userID)
+{
+	// IDs are given in order from 1
+	if (userID == 0 || userID > m_walkers.size())
+		return 0;
+	return &m_walkers[userID - 1];
+}
+
+
+unsigned int SyntheticTrackingSource::fillClosestUserIDs(unsigned int* ids, unsigned int maxUsers)
+{
+	unsigned int count = std::min<unsigned int>(m_closestIDs.size(), maxUsers);
+	std::copy(m_closestIDs.begin(), m_closestIDs.begin() + count, ids);
+	return count;
+}
+
+
+TrackedUser* SyntheticTrackingSource::getUser(unsigned int userID)
+{
+	Walker* walker = findWalker(userID);
+	return walker ? &walker->user : 0;
+}
+
+
+Fubi::Vec3f SyntheticTrackingSource::getUserHeadCenter(unsigned int userID)
+{
+	Walker* walker = findWalker(userID);
+	return walker ? walker->headCenter : Fubi::Vec3f(0, 0, 0);
+}
+
+
+Fubi::Vec3f SyntheticTrackingSource::getUserHeadRotation(unsigned int userID)
+{
+	Walker* walker = findWalker(userID);
+	return walker ? walker->headRotation : Fubi::Vec3f(0, 0, 0);
+}
+
+
+std::string SyntheticTrackingSource::getUserName(unsigned int userID)
+{
+	std::ostringstream oss;
+	oss << "User " << userID;
+	return oss.str();
+}
+
+
+void SyntheticTrackingSource::updateUserScreenWatched(unsigned int userID, int screen)
+{
+	TrackedUser* user = getUser(userID);
+	if (user)
+		user->updateScreenWatched(screen, m_time);
+}
+
+
+void SyntheticTrackingSource::resetUserInterest(unsigned int userID)
+{
+	TrackedUser* user = getUser(userID);
+	if (user)
+	{
+		user->m_interestBegTime = m_time;
+		user->m_interestTime = 0.0;
+	}
+}
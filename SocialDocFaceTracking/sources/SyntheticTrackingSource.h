@@ -0,0 +1,64 @@
+#pragma once
+
+#include "TrackingSource.h"
+
+#include <chrono>
+#include <stdint.h>
+
+/**
+* \brief Deterministic crowd walking and looking around in front of the Kinect.
+*	Same seed, same users: used to test and benchmark the attention pipeline without a sensor.
+*	Positions are in mm in the camera space, head rotations in degrees (pitch, yaw, roll)
+*	with the Fubi conventions: no rotation looks at the camera (0, 0, -1).
+*/
+class SyntheticTrackingSource : public ITrackingSource
+{
+public:
+	// realTime: one frame every 1/frameRate second, else as fast as update is called
+	SyntheticTrackingSource(unsigned int nbUsers, unsigned int seed = 1, bool realTime = true, double frameRate = 30.0);
+	~SyntheticTrackingSource();
+
+	bool init();
+	void update();
+	double getCurrentTime() { return m_time; };
+
+	void getRgbResolution(int& width, int& height);
+	bool getImage(unsigned char* buffer, int renderOptions);
+
+	std::deque<unsigned int> getClosestUserIDs() { return m_closestIDs; };
+	unsigned int fillClosestUserIDs(unsigned int* ids, unsigned int maxUsers);
+	TrackedUser* getUser(unsigned int userID);
+	Fubi::Vec3f getUserHeadCenter(unsigned int userID);
+	Fubi::Vec3f getUserHeadRotation(unsigned int userID);
+	std::string getUserName(unsigned int userID);
+	void updateUserScreenWatched(unsigned int userID, int screen);
+	void resetUserInterest(unsigned int userID);
+
+private:
+	struct Walker
+	{
+		TrackedUser user;
+		Fubi::Vec3f velocity;		// mm/s
+		Fubi::Vec3f target;			// where the user looks
+		Fubi::Vec3f headCenter;
+		Fubi::Vec3f headRotation;
+		double nextDecision;		// time of the next change of direction or target
+	};
+
+	// uniform in [min, max[
+	float random(float min, float max);
+	void decide(Walker& walker);
+	Walker* findWalker(unsigned int userID);
+
+	unsigned int m_nbUsers;
+	unsigned int m_seed;
+	uint32_t m_state;
+	bool m_realTime;
+	double m_frameTime;
+	double m_time;
+	std::chrono::steady_clock::time_point m_startClock;
+
+	std::vector<Walker> m_walkers;
+	std::deque<unsigned int> m_closestIDs;
+	std::vector<std::pair<float, unsigned int> > m_distances;
+};
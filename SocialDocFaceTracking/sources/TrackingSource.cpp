@@ -0,0 +1,28 @@
+#include "TrackingSource.h"
+
+
+void TrackedUser::updateScreenWatched(int screen, double time)
+{
+	m_screenWatchedChanged = screen != m_screenWatched;
+	if (m_screenWatchedChanged)
+	{
+		m_screenWatched = screen;
+		m_interestBegTime = time;
+	}
+
+	// no screen watched, no interest
+	m_interestTime = (m_screenWatched > 0) ? time - m_interestBegTime : 0.0;
+
+	Interest interest;
+	if (m_interestTime < 1.5)
+		interest = NONE;
+	else if (m_interestTime < 6.0)
+		interest = ORIENTING;
+	else if (m_interestTime <= 15.0)
+		interest = ENGAGED;
+	else
+		interest = STARING;
+
+	m_interestChanged = interest != m_interest;
+	m_interest = interest;
+}
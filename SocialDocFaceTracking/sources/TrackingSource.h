@@ -0,0 +1,105 @@
+#pragma once
+
+#include <Fubi/FubiMath.h>
+#include <opencv2/opencv.hpp>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "OSCUtils.h"
+
+/**
+* \brief Tracking state of one user, as read by the UserManager.
+*	Mirrors the FubiUser members used by the application, so that it does not depend on the Fubi DLL.
+*/
+struct TrackedUser
+{
+	// same values as FubiUser::Interest
+	enum Interest
+	{
+		NONE,		// < 1.5s
+		ORIENTING,	// [1.5, 6[s
+		ENGAGED,	// [6, 15]s
+		STARING		// > 15s
+	};
+
+	unsigned int m_id;
+	bool m_isTracked;
+	bool m_isFaceTracked;
+	cv::Rect m_faceRectCv;
+	Fubi::Vec3f m_torsoPosition;
+	float m_torsoConfidence;
+	Fubi::BodyMeasurementDistance m_bodyMeasurements[Fubi::BodyMeasurement::NUM_MEASUREMENTS];
+
+	int m_screenWatched;
+	bool m_screenWatchedChanged;
+	double m_interestTime;
+	double m_interestBegTime;
+	Interest m_interest;
+	bool m_interestChanged;
+
+	TrackedUser() :
+		m_id(0), m_isTracked(false), m_isFaceTracked(false), m_torsoConfidence(0),
+		m_screenWatched(0), m_screenWatchedChanged(false), m_interestTime(0), m_interestBegTime(0),
+		m_interest(NONE), m_interestChanged(false)
+		{};
+
+	/**
+	* \brief Interest update for the sources that do not rely on Fubi, same rules as FubiUser::updateScreenWatched
+	*/
+	void updateScreenWatched(int screen, double time);
+};
+
+/**
+* \brief Where the tracking data comes from: the Kinect through Fubi, a recorded session or a synthetic crowd.
+*	The functions follow the Fubi API used by the application.
+*/
+class ITrackingSource
+{
+public:
+	virtual ~ITrackingSource() {};
+
+	virtual bool init() = 0;
+	// get the next frame of tracking data (and rgb image)
+	virtual void update() = 0;
+	/**
+	* \brief Wait for the next frame of the sensor and read it, in place of update for a loop paced by the sensor.
+	*	By default a plain update: the replayed and synthetic sources keep their own pace.
+	* \return false if no frame arrived within timeoutMs, the current frame is kept
+	*/
+	virtual bool waitForFrame(int timeoutMs) { update(); return true; };
+	// time of the current frame, in seconds
+	virtual double getCurrentTime() = 0;
+	// false while there are frames to come
+	virtual bool isFinished() { return false; };
+	// switch to the next available sensor, if the source has several
+	virtual bool switchToNextSensor() { return false; };
+
+	virtual void getRgbResolution(int& width, int& height) = 0;
+	// fill a width*height*3 8 bits buffer, renderOptions as in Fubi::RenderOptions
+	virtual bool getImage(unsigned char* buffer, int renderOptions) = 0;
+
+	// user IDs sorted from the closest to the farthest user
+	virtual std::deque<unsigned int> getClosestUserIDs() = 0;
+	// same without allocation: fill ids with at most maxUsers IDs, return their number
+	virtual unsigned int fillClosestUserIDs(unsigned int* ids, unsigned int maxUsers)
+	{
+		std::deque<unsigned int> closest = getClosestUserIDs();
+		unsigned int count = 0;
+		for (; count < closest.size() && count < maxUsers; count++)
+			ids[count] = closest[count];
+		return count;
+	};
+	virtual TrackedUser* getUser(unsigned int userID) = 0;
+	// head center in mm, head rotation in degrees (pitch, yaw, roll)
+	virtual Fubi::Vec3f getUserHeadCenter(unsigned int userID) = 0;
+	virtual Fubi::Vec3f getUserHeadRotation(unsigned int userID) = 0;
+	virtual std::string getUserName(unsigned int userID) = 0;
+	virtual void updateUserScreenWatched(unsigned int userID, int screen) = 0;
+	// restart the interest timer of the user
+	virtual void resetUserInterest(unsigned int userID) = 0;
+
+	// OSC messages recorded with the tracking data, handled like the received ones
+	virtual bool popEvent(OSCMessage& mes) { return false; };
+};
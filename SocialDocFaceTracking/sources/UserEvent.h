@@ -0,0 +1,110 @@
+#pragma once
+
+#include <Fubi/FubiUtils.h>
+
+#include <string>
+#include <cstdio>
+
+/**
+* \brief Change detected by the UserManager during one frame, plain data so that a frame of
+*	events can be stored and queued without allocation. Each event maps to one OSC message.
+*/
+struct UserEvent
+{
+	enum Type
+	{
+		NB_USERS,				// /context/nbusers count
+		FACE_TRACKED_USERS,		// /context/facetrackedusers id...
+		ATTENTION,				// /context/user/attention id screen interest
+		JOINT_ATTENTION,		// /context/jointattention 1|0
+		COORDINATES,			// /context/user/coordinates id screenIndex x y
+		ATTENTION_GROUP,		// /context/jointattention/<screen> id..., no id when the group dissolved
+		ENGAGEMENT				// /context/user/engagement id screen score [screen score...]
+	};
+
+	// screens of which the engagement of a user is kept
+	static const unsigned int MAX_ENGAGED_SCREENS = 4;
+
+	Type type;
+	unsigned int userID;		// ATTENTION, COORDINATES
+	int screen;					// ATTENTION, ATTENTION_GROUP: id of the screen watched, COORDINATES: index of the screen + 1
+	int value;					// NB_USERS: number of users, ATTENTION: interest, JOINT_ATTENTION: 1 start, 0 end,
+								// FACE_TRACKED_USERS, ATTENTION_GROUP: number of ids, ENGAGEMENT: number of screens
+	float x, y;					// COORDINATES: intersection in the camera space (m)
+	unsigned short ids[Fubi::MaxUsers];	// FACE_TRACKED_USERS, ATTENTION_GROUP
+	int engagedScreens[MAX_ENGAGED_SCREENS];	// ENGAGEMENT: ids of the screens and scores [0..1]
+	float engagement[MAX_ENGAGED_SCREENS];
+
+	// longest OSC message: the face tracked users (more than the 1 + 2 * MAX_ENGAGED_SCREENS of the engagement)
+	static const unsigned int MAX_OSC_VALUES = Fubi::MaxUsers;
+
+	/**
+	* \brief OSC address and arguments of the event
+	* \param address replaced by the address, a string kept by the caller does not allocate
+	* \param values array of MAX_OSC_VALUES floats, filled by the function
+	* \return number of values
+	*/
+	unsigned int toOSC(std::string& address, float* values) const
+	{
+		static const char* addresses[] = { "/context/nbusers", "/context/facetrackedusers",
+			"/context/user/attention", "/context/jointattention", "/context/user/coordinates", "/context/jointattention/",
+			"/context/user/engagement" };
+		address.assign(addresses[type]);
+		switch (type)
+		{
+		case NB_USERS:
+		case JOINT_ATTENTION:
+			values[0] = (float)value;
+			return 1;
+		case ATTENTION_GROUP:
+		{
+			char screenID[16];
+			sprintf(screenID, "%d", screen);
+			address.append(screenID);
+			return idsToOSC(values);
+		}
+		case FACE_TRACKED_USERS:
+			return idsToOSC(values);
+		case ATTENTION:
+			values[0] = (float)userID;
+			values[1] = (float)screen;
+			values[2] = (float)value;
+			return 3;
+		case COORDINATES:
+			values[0] = (float)userID;
+			values[1] = (float)screen;
+			values[2] = x;
+			values[3] = y;
+			return 4;
+		case ENGAGEMENT:
+			values[0] = (float)userID;
+			for (int i = 0; i < value; i++)
+			{
+				values[1 + 2 * i] = (float)engagedScreens[i];
+				values[2 + 2 * i] = engagement[i];
+			}
+			return 1 + 2 * (unsigned int)value;
+		}
+		return 0;
+	}
+
+	// FACE_TRACKED_USERS, ATTENTION_GROUP: the value first ids
+	unsigned int idsToOSC(float* values) const
+	{
+		for (int i = 0; i < value; i++)
+			values[i] = (float)ids[i];
+		return (unsigned int)value;
+	}
+};
+
+// read-only view on the events of a frame
+struct UserEventView
+{
+	const UserEvent* events;
+	unsigned int size;
+
+	UserEventView(const UserEvent* e = 0, unsigned int s = 0) : events(e), size(s) {};
+	const UserEvent& operator[](unsigned int i) const { return events[i]; };
+	const UserEvent* begin() const { return events; };
+	const UserEvent* end() const { return events + size; };
+};
@@ -1,12 +1,33 @@
 #include "UserManager.h"
 // OSC includes
 #include "OSCSender.h"
+#include "SessionRecorder.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
+#include <new>
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#endif
 
-using namespace Fubi;
 
-UserManager::UserManager(bool display, const int & width, const int & height, const std::vector<std::string>& paths) :
-m_display(display), m_width(width), m_height(height), lastTime(0), m_nbUsers(0), m_nbFaceTrackedUsers(0), m_nbFaceTrackedUsersPrev(0)
+static inline unsigned int popCount(uint32_t bits)
+{
+#ifdef _MSC_VER
+	return __popcnt(bits);
+#else
+	return __builtin_popcount(bits);
+#endif
+}
+
+
+UserManager::UserManager(ITrackingSource& source, bool display, const int & width, const int & height, const std::vector<std::string>& paths) :
+m_source(source), m_display(display), m_width(width), m_height(height), lastTime(0), m_nbUsers(0), m_nbFaceTrackedUsers(0), m_nbFaceTrackedUsersPrev(0), m_recorder(0),
+m_pendingScreens(0), m_retiredScreens(0)
 {
 	// face recognizer
 	//m_recognizer = new KITV::Recognizer(paths.front());
@@ -15,221 +36,605 @@ m_display(display), m_width(width), m_height(height), lastTime(0), m_nbUsers(0),
 	m_screenManager = new KITV::ScreenManager(paths.front());
 	m_screenManager->printScreens();
 
-	// window manager
-	if (m_display)
-		m_windowManager = WindowManager();
-
-	// confidences for each distance
-	// pair<distance(mm), confidence[0..1]>
-	m_confidenceByDistance.push_back(std::pair<float, float>(800.0, 0.0));
-	m_confidenceByDistance.push_back(std::pair<float, float>(1000.0, 1.0));
-	m_confidenceByDistance.push_back(std::pair<float, float>(1500.0, 1.0));
-	m_confidenceByDistance.push_back(std::pair<float, float>(2000.0, 0.80));
-	m_confidenceByDistance.push_back(std::pair<float, float>(2500.0, 0.60));
-	m_confidenceByDistance.push_back(std::pair<float, float>(3000.0, 2.0));
-	m_confidenceByDistance.push_back(std::pair<float, float>(4000.0, 0.0));
-	std::sort(m_confidenceByDistance.begin(), m_confidenceByDistance.end());
+	init();
+}
+
+
+UserManager::UserManager(ITrackingSource& source, bool display, const int & width, const int & height, KITV::ScreenManager* screenManager) :
+m_source(source), m_display(display), m_width(width), m_height(height), lastTime(0), m_nbUsers(0), m_nbFaceTrackedUsers(0), m_nbFaceTrackedUsersPrev(0), m_recorder(0),
+m_screenManager(screenManager), m_pendingScreens(0), m_retiredScreens(0)
+{
+	init();
+}
+
+
+void UserManager::init()
+{
+	m_nbUsersPrev = 0;
+	m_allUsersLookingSameScreen = false;
+	m_allUsersLookingSameScreenPrev = false;
 
 	// init filters for face tracking
 	m_faceTrackedUsersFilterSize = 3;
-	m_faceTrackedUsersFilter[1] = std::deque<bool>(m_faceTrackedUsersFilterSize, false);
-	m_faceTrackedUsersFilter[2] = std::deque<bool>(m_faceTrackedUsersFilterSize, false);
-	m_faceTrackedUsersFilter[3] = std::deque<bool>(m_faceTrackedUsersFilterSize, false);
-	m_faceTrackedUsersFilter[4] = std::deque<bool>(m_faceTrackedUsersFilterSize, false);
-	m_faceTrackedUsersFilter[5] = std::deque<bool>(m_faceTrackedUsersFilterSize, false);
-	m_faceTrackedUsersFilter[6] = std::deque<bool>(m_faceTrackedUsersFilterSize, false);
+	m_faceTrackedMinFrames = 1;
+	// no budget: every user at full rate
+	m_fullRateUsers = Fubi::MaxUsers;
+	m_decimation = 4;
+	m_frameCount = 0;
+	m_faceTrackedUsers.reserve(Fubi::MaxUsers);
+	m_nbEvents = 0;
+	// about 150 ms at 30 fps
+	m_groupStableFrames = 5;
+	m_nbGroups = 0;
+	m_groupsOverflow = false;
+	m_nbChangedGroups = 0;
+	// the engagement twice a second
+	m_engagementTimeConstant = 5.0f;
+	m_engagementPeriod = 0.5f;
+	m_lastEngagementTime = 0;
+	m_sendEngagement = false;
+	m_attentionFrame = AttentionState();
+	if (m_display)
+	{
+		// faces of the frame being annotated, in the display queue (2) and shown
+		m_facePool.reserve(4 * Fubi::MaxUsers, FacePanel::WIDTH, FacePanel::HEIGHT);
+		m_faces.reserve(Fubi::MaxUsers);
+		for (unsigned int i = 0; i < Fubi::MaxUsers; i++)
+			m_panels[i].init();
+	}
+}
+
+
+void* UserManager::operator new(size_t size)
+{
+	void* p = 0;
+#ifdef _MSC_VER
+	p = _aligned_malloc(size, __alignof(UserSlot));
+#else
+	if (posix_memalign(&p, alignof(UserSlot), size) != 0)
+		p = 0;
+#endif
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+
+void UserManager::operator delete(void* p)
+{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	free(p);
+#endif
 }
 
 
 UserManager::~UserManager()
 {
+	delete m_screenManager;
+	delete m_pendingScreens.exchange(0);
+	delete m_retiredScreens.exchange(0);
+}
+
+
+void UserManager::setScreenManager(KITV::ScreenManager* screenManager)
+{
+	// the update that retired these screens is over, nobody uses them anymore
+	delete m_retiredScreens.exchange(0);
+	// screens published but never picked by an update are dropped
+	delete m_pendingScreens.exchange(screenManager);
 }
 
 void UserManager::update(const cv::Mat & rgb, bool resetTimers)
 {
-	m_attentionChanged.clear();
-	m_intersectionCoordinates.clear();
-	// get the currents users in scene
-	std::deque<unsigned int> ids = getClosestUserIDs();
-	m_users = Fubi::getClosestUsers();
+	m_faces.clear();
+
+	// screens reloaded since the last update, the old ones are freed by the next setScreenManager
+	KITV::ScreenManager* screens = m_pendingScreens.exchange(0);
+	if (screens)
+	{
+		KITV::ScreenManager* previous = m_screenManager;
+		m_screenManager = screens;
+		delete m_retiredScreens.exchange(previous);
+	}
+	// get the currents users in scene, read once for the whole frame
+	m_snapshot.capture(m_source);
+	const UserSnapshot& snapshot = m_snapshot;
 	m_nbUsersPrev = m_nbUsers;
-	m_nbUsers = ids.size();
+	m_nbUsers = snapshot.count;
 	
 	m_allUsersLookingSameScreenPrev = m_allUsersLookingSameScreen;
 
+	// face tracking filters: make room for this frame
+	uint32_t historyMask = (1u << m_faceTrackedUsersFilterSize) - 1;
+	for (unsigned int i = 0; i < Fubi::MaxUsers; i++)
+		m_slots[i].faceTrackedHistory = (m_slots[i].faceTrackedHistory << 1) & historyMask;
+
+	// confidence of the head rotation of every user
+	m_screenManager->getConfidenceCurve().evaluate(snapshot.headDistances, m_headConfidences, snapshot.count);
+
 	// update users
-	for (unsigned int i = 0; i < m_nbUsers; i++)
+	unsigned int candidates[Fubi::MaxUsers];
+	unsigned int nbCandidates = 0;
+	unsigned int untrusted[Fubi::MaxUsers];
+	unsigned int nbUntrusted = 0;
+	for (unsigned int i = 0; i < snapshot.count; i++)
 	{
-		FubiUser* tempUser = Fubi::getUser(ids[i]);
+		if (m_recorder)
+			m_recorder->recordUser(snapshot, i);
 
 		if (resetTimers)
+			m_source.resetUserInterest(snapshot.ids[i]);
+
+		m_snapshotSlots[i] = Fubi::MaxUsers;
+		if (snapshot.isFaceTracked[i])
 		{
-			tempUser->m_interestBegTime = getCurrentTime();
-			tempUser->m_interestTime = 0.0;
+			UserSlot& slot = getSlot(snapshot.ids[i]);
+			slot.faceTrackedHistory |= 1;
+			m_snapshotSlots[i] = (unsigned int)(&slot - m_slots);
+			if (m_headConfidences[i] > 0)
+				candidates[nbCandidates++] = i;
+			else
+				untrusted[nbUntrusted++] = i;
 		}
+	}
 
-		if (tempUser->m_isFaceTracked)
+	// compute budget: the m_fullRateUsers most reliable users every frame, the others one frame out of m_decimation
+	if (nbCandidates > m_fullRateUsers)
+	{
+		const float* confidences = m_headConfidences;
+		std::sort(candidates, candidates + nbCandidates, [confidences, &snapshot](unsigned int a, unsigned int b)
 		{
-			m_faceTrackedUsersFilter[ids[i]].pop_front();
-			m_faceTrackedUsersFilter[ids[i]].push_back(true);
+			if (confidences[a] != confidences[b])
+				return confidences[a] > confidences[b];
+			return snapshot.headDistances[a] < snapshot.headDistances[b];
+		});
+	}
+	bool scheduled[Fubi::MaxUsers] = { false };
+	for (unsigned int rank = 0; rank < nbCandidates; rank++)
+	{
+		// spread the decimated users over the frames
+		unsigned int i = candidates[rank];
+		scheduled[i] = rank < m_fullRateUsers || (m_frameCount + snapshot.ids[i]) % m_decimation == 0;
+	}
+	// in the order of the tracking source, whatever the budget
+	unsigned int nbGazes = 0;
+	for (unsigned int i = 0; i < snapshot.count; i++)
+	{
+		if (!scheduled[i])
+			continue;
+		m_gazeIndices[nbGazes] = i;
+		m_gazes[nbGazes] = GazeRay::fromHead(snapshot.headCenters[i], snapshot.headRotations[i]);
+		nbGazes++;
+	}
+	m_frameCount++;
+
+	// all the scheduled users against all the screens
+	m_screenManager->whichScreensBeingWatched(m_gazes, nbGazes, m_hits);
+
+	// users too close or too far, their head rotation is not trusted: no screen watched
+	unsigned int nbUpdated = nbGazes;
+	for (unsigned int i = 0; i < nbUntrusted; i++)
+	{
+		m_gazeIndices[nbUpdated] = untrusted[i];
+		m_hits[nbUpdated] = KITV::ScreenHit();
+		nbUpdated++;
+	}
 
+	// the tracking source is not thread safe: screens watched and names on this thread
+	for (unsigned int i = 0; i < nbUpdated; i++)
+		m_source.updateUserScreenWatched(snapshot.ids[m_gazeIndices[i]], m_hits[i].id);
 
-			// update screen watched
-			std::pair<int, cv::Point3f> sw = userWatchingScreen(tempUser->m_id);
-			updateUserScreenWatched(tempUser->m_id, sw.first);
-			if (tempUser->m_interestChanged)
-				m_attentionChanged.push_back(tempUser->m_id);
-			if (sw.first > 0)
-				m_intersectionCoordinates[tempUser->m_id] = sw.second;
+	//display face and other information
+	if (m_display && !rgb.empty())
+	{
+		// no free buffer: the display is lagging and keeps the previous face of the user
+		for (unsigned int i = 0; i < nbGazes; i++)
+		{
+			m_faceNames[i] = m_source.getUserName(snapshot.ids[m_gazeIndices[i]]);
+			m_faceImages[i] = m_facePool.acquire(FacePanel::WIDTH, FacePanel::HEIGHT);
+		}
 
-			
-			//display face and other information
-			if (m_display)
+		// crops and annotations, one user per task
+		auto annotate = [&](unsigned int i)
+		{
+			if (m_faceImages[i].empty())
+				return;
+			unsigned int index = m_gazeIndices[i];
+			// face outside of the image: no crop, the buffer goes back to the pool
+			cv::Rect faceRect = getFaceRect(snapshot.faceRects[index], rgb.size());
+			if (faceRect.area() <= 0)
 			{
-				//get the face from the image
-				cv::Mat face = rgb(getFaceRect(tempUser));
+				m_faceImages[i].release();
+				return;
+			}
+			//get the face from the image, resized in place in the top of the panel
+			cv::Mat face = m_faceImages[i].image().rowRange(0, FacePanel::FACE_HEIGHT);
+			cv::resize(rgb(faceRect), face, face.size());
+			addInfoToFace(index, m_faceNames[i], m_faceImages[i].image());
+		};
+		m_pool.parallelFor(nbGazes, annotate);
+
+		for (unsigned int i = 0; i < nbGazes; i++)
+		{
+			if (!m_faceImages[i].empty())
+				m_faces.push_back(std::pair<unsigned int, FramePool::Frame>(snapshot.ids[m_gazeIndices[i]], m_faceImages[i]));
+			m_faceImages[i].release();
+		}
+	}
+
+	updateEngagement();
+	updateFaceTrackedUsers();
+
+	// joint attention
+	if (snapshot.count > 1)
+	{
+		m_allUsersLookingSameScreen = true;
+		int screenWatched = snapshot.users[0]->m_screenWatched;
+		for (unsigned int i = 1; i < snapshot.count; i++)
+			m_allUsersLookingSameScreen &= snapshot.users[i]->m_screenWatched == screenWatched;
+	}
 
-				cv::resize(face, face, cv::Size(240, 320));
-				addInfoToFace(tempUser, face);
-				m_windowManager.show(face, FACE, tempUser->m_id);
+	else
+		m_allUsersLookingSameScreen = false;
+	updateAttentionGroups();
+
+	publishEvents(nbUpdated);
+	publishAttention();
+}
+
+
+UserEvent& UserManager::addEvent(UserEvent::Type type)
+{
+	// MAX_EVENTS covers every event a frame can produce
+	UserEvent& event = m_events[m_nbEvents++];
+	event.type = type;
+	event.userID = 0;
+	event.screen = 0;
+	event.value = 0;
+	event.x = event.y = 0;
+	return event;
+}
+
+
+void UserManager::publishEvents(unsigned int nbUpdated)
+{
+	m_nbEvents = 0;
+	if (nbUsersHasChanged())
+		addEvent(UserEvent::NB_USERS).value = m_nbUsers;
+	if (nbFaceTrackedUsersChanged())
+	{
+		UserEvent& event = addEvent(UserEvent::FACE_TRACKED_USERS);
+		event.value = (int)m_faceTrackedUsers.size();
+		std::copy(m_faceTrackedUsers.begin(), m_faceTrackedUsers.end(), event.ids);
+	}
+	for (unsigned int i = 0; i < nbUpdated; i++)
+	{
+		const TrackedUser* user = m_snapshot.users[m_gazeIndices[i]];
+		if (user->m_interestChanged)
+		{
+			UserEvent& event = addEvent(UserEvent::ATTENTION);
+			event.userID = user->m_id;
+			event.screen = user->m_screenWatched;
+			event.value = user->m_interest;
+		}
+	}
+	if (jointAttentionStart() || jointAttentionEnd())
+		addEvent(UserEvent::JOINT_ATTENTION).value = jointAttentionStart() ? 1 : 0;
+	for (unsigned int i = 0; i < m_nbChangedGroups; i++)
+	{
+		const AttentionGroup& group = m_groups[m_changedGroups[i]];
+		UserEvent& event = addEvent(UserEvent::ATTENTION_GROUP);
+		event.screen = group.screen;
+		event.value = (int)group.nbMembers;
+		std::copy(group.members, group.members + group.nbMembers, event.ids);
+	}
+	for (unsigned int i = 0; m_sendEngagement && i < Fubi::MaxUsers; i++)
+	{
+		const UserSlot& slot = m_slots[i];
+		if (slot.id == 0)
+			continue;
+		UserEvent* event = 0;
+		for (unsigned int k = 0; k < UserEvent::MAX_ENGAGED_SCREENS; k++)
+		{
+			// scores faded away are not worth sending
+			if (slot.engagedScreens[k] == 0 || slot.engagement[k] < 0.01f)
+				continue;
+			if (!event)
+			{
+				event = &addEvent(UserEvent::ENGAGEMENT);
+				event->userID = slot.id;
 			}
+			event->engagedScreens[event->value] = slot.engagedScreens[k];
+			event->engagement[event->value] = slot.engagement[k];
+			event->value++;
+		}
+	}
+	for (unsigned int i = 0; i < nbUpdated; i++)
+	{
+		const KITV::ScreenHit& hit = m_hits[i];
+		if (hit.id > 0)
+		{
+			UserEvent& event = addEvent(UserEvent::COORDINATES);
+			event.userID = m_snapshot.ids[m_gazeIndices[i]];
+			event.screen = (int)hit.index + 1;
+			event.x = hit.point.x;
+			event.y = hit.point.y;
 		}
 	}
+}
 
-	//update face tracked users
-	m_faceTrackedUsers.clear();
-	m_nbFaceTrackedUsersPrev = m_nbFaceTrackedUsers;
-	m_nbFaceTrackedUsers = 0;
-	for (std::map<unsigned short, std::deque<bool>>::iterator it = m_faceTrackedUsersFilter.begin(); it != m_faceTrackedUsersFilter.end(); ++it)
+void UserManager::updateEngagement()
+{
+	// frame delta, bounded so that a pause of the source does not wipe the scores
+	double elapsed = (lastTime > 0) ? std::min(std::max(m_snapshot.time - lastTime, 0.0), 1.0) : 0.0;
+	lastTime = m_snapshot.time;
+	float decay = (float)std::exp(-elapsed / m_engagementTimeConstant);
+
+	for (unsigned int i = 0; i < Fubi::MaxUsers; i++)
+	{
+		UserSlot& slot = m_slots[i];
+		for (unsigned int k = 0; k < UserEvent::MAX_ENGAGED_SCREENS; k++)
+			slot.engagement[k] *= decay;
+	}
+	for (unsigned int i = 0; i < m_snapshot.count; i++)
 	{
-		std::deque<bool> tracked = it->second;
-		int trackedTimes = 0;
-		for (int j = 0; j < tracked.size(); j++)
+		int screen = m_snapshot.users[i]->m_screenWatched;
+		if (m_snapshotSlots[i] == Fubi::MaxUsers || screen == 0)
+			continue;
+		// the entry of the screen, else the least engaged one is taken
+		UserSlot& slot = m_slots[m_snapshotSlots[i]];
+		unsigned int entry = 0;
+		for (unsigned int k = 0; k < UserEvent::MAX_ENGAGED_SCREENS; k++)
 		{
-			if (tracked[j])
-				trackedTimes++;
+			if (slot.engagedScreens[k] == screen)
+			{
+				entry = k;
+				break;
+			}
+			if (slot.engagement[k] < slot.engagement[entry])
+				entry = k;
 		}
-		if (trackedTimes >= 1)
+		if (slot.engagedScreens[entry] != screen)
 		{
-			m_nbFaceTrackedUsers++;
-			m_faceTrackedUsers.push_back(it->first);
+			slot.engagedScreens[entry] = screen;
+			slot.engagement[entry] = 0.0f;
 		}
+		slot.engagement[entry] += 1.0f - decay;
 	}
 
-	// joint attention
-	if (m_users.size() > 1)
+	m_sendEngagement = m_engagementPeriod > 0 && m_snapshot.time - m_lastEngagementTime >= m_engagementPeriod;
+	if (m_sendEngagement)
+		m_lastEngagementTime = m_snapshot.time;
+}
+
+
+void UserManager::updateAttentionGroups()
+{
+	// groups dissolved during the last update, once published
+	unsigned int nbKept = 0;
+	for (unsigned int g = 0; g < m_nbGroups; g++)
 	{
-		m_allUsersLookingSameScreen = true;
-		int screenWatched = m_users.front()->m_screenWatched;
-		std::deque<FubiUser*>::iterator user = m_users.begin();
-		user++;
-		for (user; user != m_users.end(); ++user)
+		if (m_groups[g].nbMembers > 0 || m_groups[g].nbCandidates > 0)
+			m_groups[nbKept++] = m_groups[g];
+	}
+	m_nbGroups = nbKept;
+	if (m_nbGroups < MAX_GROUPS)
+		m_groupsOverflow = false;
+
+	// watchers of each screen this frame. Only the face tracked users: the others keep their last screen
+	int screens[Fubi::MaxUsers];
+	unsigned int nbWatchers[Fubi::MaxUsers];
+	unsigned short watchers[Fubi::MaxUsers][Fubi::MaxUsers];
+	unsigned int nbScreens = 0;
+	for (unsigned int i = 0; i < m_snapshot.count; i++)
+	{
+		int screen = m_snapshot.users[i]->m_screenWatched;
+		if (!m_snapshot.isFaceTracked[i] || screen == 0)
+			continue;
+		unsigned int s = 0;
+		while (s < nbScreens && screens[s] != screen)
+			s++;
+		if (s == nbScreens)
 		{
-			m_allUsersLookingSameScreen &= (*user)->m_screenWatched == screenWatched;
+			screens[nbScreens] = screen;
+			nbWatchers[nbScreens++] = 0;
+		}
+		watchers[s][nbWatchers[s]++] = (unsigned short)m_snapshot.ids[i];
+	}
+	for (unsigned int s = 0; s < nbScreens; s++)
+	{
+		// alone in front of a screen is no shared attention
+		if (nbWatchers[s] < 2)
+		{
+			nbWatchers[s] = 0;
+			continue;
+		}
+		std::sort(watchers[s], watchers[s] + nbWatchers[s]);
+		unsigned int g = 0;
+		while (g < m_nbGroups && m_groups[g].screen != screens[s])
+			g++;
+		if (g == m_nbGroups && m_nbGroups == MAX_GROUPS)
+		{
+			if (!m_groupsOverflow)
+				std::cerr << "Too many attention groups, the group of screen " << screens[s] << " is ignored" << std::endl;
+			m_groupsOverflow = true;
+			continue;
+		}
+		if (g == m_nbGroups)
+		{
+			AttentionGroup& group = m_groups[m_nbGroups++];
+			group.screen = screens[s];
+			group.nbMembers = 0;
+			group.nbCandidates = 0;
+			group.stableFrames = 0;
 		}
 	}
 
-	else
-		m_allUsersLookingSameScreen = false;
-	
-	if (m_display)
-		m_windowManager.clearUnused(ids);
+	// hysteresis: a change is only published when it lasted m_groupStableFrames frames
+	m_nbChangedGroups = 0;
+	for (unsigned int g = 0; g < m_nbGroups; g++)
+	{
+		AttentionGroup& group = m_groups[g];
+		unsigned int s = 0;
+		while (s < nbScreens && screens[s] != group.screen)
+			s++;
+		const unsigned short* ids = (s < nbScreens) ? watchers[s] : 0;
+		unsigned int nbIDs = (s < nbScreens) ? nbWatchers[s] : 0;
+
+		if (nbIDs == group.nbMembers && std::equal(ids, ids + nbIDs, group.members))
+		{
+			// back to the published members
+			group.nbCandidates = 0;
+			group.stableFrames = 0;
+			continue;
+		}
+		if (nbIDs != group.nbCandidates || !std::equal(ids, ids + nbIDs, group.candidates) || group.stableFrames == 0)
+		{
+			std::copy(ids, ids + nbIDs, group.candidates);
+			group.nbCandidates = nbIDs;
+			group.stableFrames = 0;
+		}
+		if (++group.stableFrames >= m_groupStableFrames)
+		{
+			std::copy(ids, ids + nbIDs, group.members);
+			group.nbMembers = nbIDs;
+			group.nbCandidates = 0;
+			group.stableFrames = 0;
+			m_changedGroups[m_nbChangedGroups++] = g;
+		}
+	}
 }
 
-cv::Rect UserManager::getFaceRect(FubiUser* user)
+
+void UserManager::publishAttention()
 {
-	cv::Rect faceRect = user->m_faceRectCv;
-	if (faceRect.x < 0) faceRect.x = 0;
-	if (faceRect.y < 0) faceRect.y = 0;
-	if ((faceRect.x + faceRect.width) > m_width)  faceRect.width = m_width - faceRect.x;
-	if ((faceRect.y + faceRect.height) > m_height) faceRect.height = m_height - faceRect.y;
-	return faceRect;
+	AttentionState& state = m_attentionFrame;
+	state.frame++;
+	state.time = m_snapshot.time;
+	state.nbUsers = m_snapshot.count;
+	state.jointAttention = m_allUsersLookingSameScreen;
+	for (unsigned int i = 0; i < m_snapshot.count; i++)
+	{
+		const TrackedUser* user = m_snapshot.users[i];
+		UserAttention& attention = state.users[i];
+		attention.id = m_snapshot.ids[i];
+		attention.isFaceTracked = m_snapshot.isFaceTracked[i];
+		attention.screenWatched = user->m_screenWatched;
+		attention.interest = user->m_interest;
+		attention.interestTime = (float)user->m_interestTime;
+		attention.headConfidence = m_snapshot.isFaceTracked[i] ? m_headConfidences[i] : 0.0f;
+		attention.headDistance = m_snapshot.isFaceTracked[i] ? m_snapshot.headDistances[i] : 0.0f;
+	}
+	m_attention.publish(state);
 }
 
-float UserManager::getHeadRotationConfidence(FubiUser* user)
+
+void UserManager::updateFaceTrackedUsers()
 {
-	std::vector<float> faceCenter = getUserHeadCenter(user->m_id);
-	Fubi::Vec3f fcenter(faceCenter[0], faceCenter[1], faceCenter[2]);
-	Fubi::Vec3f origin(0, 0, 0);
-	float dist = (fcenter - origin).length();
-	
-	// out of bounds -> confidence = 0
-	if (dist < m_confidenceByDistance.front().first || dist >= m_confidenceByDistance.back().first)
-		return 0.0;
-	
-	// else calculate confidence (linear interpolation on distance)
-	for (unsigned int i = 1; i < m_confidenceByDistance.size(); i++)
+	m_faceTrackedUsers.clear();
+	m_nbFaceTrackedUsersPrev = m_nbFaceTrackedUsers;
+	m_nbFaceTrackedUsers = 0;
+	for (unsigned int i = 0; i < Fubi::MaxUsers; i++)
 	{
-		if (dist >= m_confidenceByDistance[i - 1].first && dist < m_confidenceByDistance[i].first)
+		UserSlot& slot = m_slots[i];
+		if (slot.id == 0)
+			continue;
+		if (popCount(slot.faceTrackedHistory) >= m_faceTrackedMinFrames)
 		{
-			float a = (m_confidenceByDistance[i].second - m_confidenceByDistance[i - 1].second) /
-				(m_confidenceByDistance[i].first - m_confidenceByDistance[i - 1].first);
-
-			return m_confidenceByDistance[i - 1].second + a * (dist - m_confidenceByDistance[i - 1].first);
+			m_nbFaceTrackedUsers++;
+			m_faceTrackedUsers.push_back(slot.id);
 		}
+		else if (slot.faceTrackedHistory == 0)
+			slot.id = 0;	// not seen during the whole filter, free the slot
 	}
-	return 0.0;
+	// by ID, as the OSC clients expect
+	std::sort(m_faceTrackedUsers.begin(), m_faceTrackedUsers.end());
 }
 
-void  UserManager::addInfoToFace(FubiUser* user, cv::Mat& image)
+
+UserSlot& UserManager::getSlot(unsigned int userID)
 {
-	int org(image.size().height);
-	std::vector<std::string> lines;
-
-	std::vector<float> faceCenter = getUserHeadCenter(user->m_id);
-	// convert from mm to meters
-	for (unsigned int i = 0; i < faceCenter.size(); i++)
-		faceCenter[i] /= 1000.0;
-	std::vector<float> faceRotation = getUserHeadRotation(user->m_id);
-
-	std::ostringstream oss;
-	oss << getUserName(user->m_id) << " watches screen " << user->m_screenWatched;
-	lines.push_back(oss.str());
-
-	oss.clear();
-	oss.str("");
-	oss.precision(2);
-	oss.setf(std::ios::fixed);
-	oss << "x : " << faceCenter[0] << "  pitch : " << faceRotation[0];
-	lines.push_back(oss.str());
-
-	oss.clear();
-	oss.str("");
-	oss << "y : " << faceCenter[1] << "  yaw : " << faceRotation[1];
-	lines.push_back(oss.str());
-	
-	oss.clear();
-	oss.str("");
-	oss << "z : " << faceCenter[2] << "  roll : " << faceRotation[2];
-	lines.push_back(oss.str());
+	unsigned int found = Fubi::MaxUsers;
+	for (unsigned int i = 0; i < Fubi::MaxUsers; i++)
+	{
+		if (m_slots[i].id == userID)
+			return m_slots[i];
+		// prefer a free slot, else the one tracked the longest time ago
+		if (found == Fubi::MaxUsers || (m_slots[found].id != 0
+			&& (m_slots[i].id == 0 || m_slots[i].faceTrackedHistory < m_slots[found].faceTrackedHistory)))
+			found = i;
+	}
+	m_slots[found] = UserSlot();
+	m_slots[found].id = userID;
+	return m_slots[found];
+}
+
+cv::Rect UserManager::getFaceRect(const cv::Rect& rect, const cv::Size& imageSize)
+{
+	// the image given to this update, its size changes with the sensor
+	return rect & cv::Rect(0, 0, imageSize.width, imageSize.height);
+}
 
-	oss.clear();
-	oss.str("");
-	oss << "confidence : " << getHeadRotationConfidence(user);
-	lines.push_back(oss.str());
+float UserManager::getHeadRotationConfidence(float dist)
+{
+	return m_screenManager->getConfidenceCurve()(dist);
+}
+
+void  UserManager::addInfoToFace(unsigned int index, const std::string& name, cv::Mat& image)
+{
+	TrackedUser* user = m_snapshot.users[index];
+	// the slot of the user keeps the lines drawn for the previous frames
+	FacePanel& panel = m_panels[m_snapshotSlots[index]];
+	panel.setUser(m_snapshot.ids[index]);
+	char text[128];
+	char value0[16], value1[16];
+
+	if (panel.changed(name, user->m_screenWatched))
+	{
+		sprintf(text, "%.80s watches screen %d", name.c_str(), user->m_screenWatched);
+		panel.setLine(0, text);
+	}
+
+	// meters and degrees, shown to the hundredth
+	Fubi::Vec3f faceCenter = m_snapshot.headCenters[index] / 10.0f;
+	const Fubi::Vec3f& faceRotation = m_snapshot.headRotations[index];
+	int position[3] = { cvRound(faceCenter.x), cvRound(faceCenter.y), cvRound(faceCenter.z) };
+	int rotation[3] = { cvRound(faceRotation.x * 100.0f), cvRound(faceRotation.y * 100.0f), cvRound(faceRotation.z * 100.0f) };
+	static const char* axes[3][2] = { { "x", "pitch" }, { "y", "yaw" }, { "z", "roll" } };
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		if (!panel.changed(1 + i, position[i], rotation[i]))
+			continue;
+		FacePanel::formatHundredths(value0, position[i]);
+		FacePanel::formatHundredths(value1, rotation[i]);
+		sprintf(text, "%s : %s  %s : %s", axes[i][0], value0, axes[i][1], value1);
+		panel.setLine(1 + i, text);
+	}
+
+	int confidence = cvRound(m_headConfidences[index] * 100.0f);
+	if (panel.changed(4, confidence))
+	{
+		FacePanel::formatHundredths(value0, confidence);
+		sprintf(text, "confidence : %s", value0);
+		panel.setLine(4, text);
+	}
 
 	// dist(left shoulder - right shoulder)
 	Fubi::BodyMeasurementDistance shoulderWidth = user->m_bodyMeasurements[Fubi::BodyMeasurement::SHOULDER_WIDTH];
-		
-	if (shoulderWidth.m_confidence>0.9)
+	//age based on dist(left shoulder - right shoulder) en croissance age=0.08*taillemm-14.8  1.5 d'offset car distance epaule? 
+	bool ageKnown = shoulderWidth.m_confidence > 0.9;
+	int age = ageKnown ? (int)(0.08*1.5*shoulderWidth.m_dist - 14.8) : 0;
+	if (panel.changed(5, age, ageKnown))
 	{
-		oss.clear();
-		oss.str("");
-		//age based on dist(left shoulder - right shoulder) en croissance age=0.08*taillemm-14.8  1.5 d'offset car distance epaule? 
-		int age = 0.08*1.5*shoulderWidth.m_dist - 14.8;
-
-		int AgeSeuil = 13;
-		oss << "age estimation = " << age;
-		lines.push_back(oss.str());
+		sprintf(text, "age estimation = %d", age);
+		panel.setLine(5, ageKnown ? text : 0);
 	}
 
-	cv::Mat blackMat(lines.size()*12+4, image.size().width, CV_8UC3, cv::Scalar(0, 0, 0));
-	cv::vconcat(image, blackMat, image);
-
-	for (unsigned int i = 0; i < lines.size(); i++)
-		cv::putText(image, lines[i], cv::Point(8, org + (i+1)*12), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(255, 255, 255));
+	panel.draw(image);
 
-	// print a rectangle fo interest
+	// print a rectangle fo interest, in place over the face
 	double time = user->m_interestTime;
 	cv::Rect interestRect;
 	cv::Scalar interestColor;
@@ -265,28 +670,14 @@ void  UserManager::addInfoToFace(FubiUser* user, cv::Mat& image)
 
 std::pair<int, cv::Point3f> UserManager::userWatchingScreen(int userID)
 {
-	std::vector<float> faceCenter = getUserHeadCenter(userID);
-	std::vector<float> faceRotation = getUserHeadRotation(userID);
-
-	// convert from mm to meters
-	for (unsigned int i = 0; i < faceCenter.size(); i++)
-		faceCenter[i] /= 1000.0;
-
-	cv::Mat mat_translation = cv::Mat(faceCenter);
-	cv::Mat mat_rotation;
-	cv::Rodrigues(cv::Mat(faceRotation) * CV_PI / 180, mat_rotation);
-
-	cv::Point3f gaze1;
-	gaze1.x = faceCenter[0];
-	gaze1.y = faceCenter[1];
-	gaze1.z = faceCenter[2];
-
-	cv::Point3f gaze2;
-	cv::Mat m = (cv::Mat_<float>(3, 1) << 0, 0, -1);
-	cv::Mat mat_gaze2 = mat_rotation * m + mat_translation;
-	gaze2.x = mat_gaze2.at<float>(0);
-	gaze2.y = mat_gaze2.at<float>(1);
-	gaze2.z = mat_gaze2.at<float>(2);
-
-	return m_screenManager->whichScreenBeingWatched(gaze1, gaze2);
+	// only the face tracked users have a gaze
+	int index = m_snapshot.find(userID);
+	if (index < 0 || !m_snapshot.isFaceTracked[index])
+		return std::pair<int, cv::Point3f>(0, cv::Point3f());
+	GazeRay gaze = GazeRay::fromHead(m_snapshot.headCenters[index], m_snapshot.headRotations[index]);
+	KITV::ScreenHit hit = m_screenManager->whichScreenBeingWatched(gaze);
+	if (hit.id == 0)
+		return std::pair<int, cv::Point3f>(0, cv::Point3f());
+	// z: index of the screen + 1, as sent in the coordinates OSC message
+	return std::pair<int, cv::Point3f>(hit.id, cv::Point3f(hit.point.x, hit.point.y, (float)(hit.index + 1)));
 }
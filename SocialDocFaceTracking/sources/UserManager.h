@@ -1,38 +1,137 @@
 #pragma once
 
 #include <vector>
-#include <opencv2\opencv.hpp>
-
-#include <Fubi\Fubi.h>
-#include <Fubi\FubiUser.h>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+#include <opencv2/opencv.hpp>
 
 #include "screen.h"
+#include "TrackingSource.h"
+#include "UserSnapshot.h"
+#include "UserEvent.h"
+#include "WorkPool.h"
+#include "AttentionState.h"
+#include "SeqLock.h"
+#include "FramePool.h"
+#include "FacePanel.h"
+
+class SessionRecorder;
 
-#include "WindowManager.h"
+// state kept by the manager for one user, one cache line each
+struct KISD_CACHE_ALIGNED UserSlot
+{
+	unsigned int id;				// 0 if the slot is free
+	uint32_t faceTrackedHistory;	// one bit per frame, bit 0 is the current frame
+	// share of the last seconds spent watching each of the last screens watched, decayed every frame
+	int engagedScreens[UserEvent::MAX_ENGAGED_SCREENS];	// 0 if the entry is free
+	float engagement[UserEvent::MAX_ENGAGED_SCREENS];
+	UserSlot() : id(0), faceTrackedHistory(0)
+	{
+		std::fill(engagedScreens, engagedScreens + UserEvent::MAX_ENGAGED_SCREENS, 0);
+		std::fill(engagement, engagement + UserEvent::MAX_ENGAGED_SCREENS, 0.0f);
+	};
+};
+
+// users sharing their attention on one screen
+struct AttentionGroup
+{
+	int screen;
+	unsigned int nbMembers;						// published members, by ID, none or at least two
+	unsigned short members[Fubi::MaxUsers];
+	unsigned int nbCandidates;					// watchers different from the members, seen during stableFrames frames
+	unsigned short candidates[Fubi::MaxUsers];
+	unsigned int stableFrames;
+};
 
 class UserManager
 {
 public:
-	UserManager(bool display, const int & width, const int & height, const std::vector<std::string>& paths);
+	UserManager(ITrackingSource& source, bool display, const int & width, const int & height, const std::vector<std::string>& paths);
+	// screens defined by code, the manager takes ownership of screenManager
+	UserManager(ITrackingSource& source, bool display, const int & width, const int & height, KITV::ScreenManager* screenManager);
 	~UserManager();
+	// the user slots are cache aligned, so must be the manager allocated on the heap
+	static void* operator new(size_t size);
+	static void operator delete(void* p);
 	
+	/**
+	* \brief Attention groups kept, one per screen: the groups of this frame (at most MaxUsers / 2, two watchers
+	*	each) and the published groups whose change waits for m_groupStableFrames frames. Their members may have
+	*	moved to another group meanwhile, users switching screens at every frame can keep several of them alive.
+	*	A group which does not fit is ignored, reported once on std::cerr until the table has room again.
+	*/
+	static const unsigned int MAX_GROUPS = 2 * Fubi::MaxUsers;
+	// number of users, face tracked users and attention changes, joint attention start and end, gaze coordinates,
+	// engagement, attention groups changes
+	static const unsigned int MAX_EVENTS = 4 * Fubi::MaxUsers + 3 + MAX_GROUPS;
+
 	bool nbUsersHasChanged() { return m_nbUsers != m_nbUsersPrev; };
-	std::vector<unsigned short> attentionChanged() { return m_attentionChanged; };
-	std::map<int, cv::Point3f> intersectionCoordinates() { return m_intersectionCoordinates; };
 	void update(const cv::Mat & rgb, bool resetTimers = false);
+	// changes of the last update, in the order of the OSC messages; valid until the next update
+	UserEventView getEvents() const { return UserEventView(m_events, m_nbEvents); };
 	unsigned short getNbUsers() { return m_nbUsers; };
 	std::pair<int, cv::Point3f> userWatchingScreen(int userID);
 	bool jointAttentionStart() { return m_allUsersLookingSameScreen && !m_allUsersLookingSameScreenPrev; };
 	bool jointAttentionEnd() { return !m_allUsersLookingSameScreen && m_allUsersLookingSameScreenPrev; };
-	std::vector<unsigned short> getFaceTrackedUsers() {return m_faceTrackedUsers;};
+	// screens watched by at least two users, members changes are published after m_groupStableFrames frames
+	const AttentionGroup* getAttentionGroups(unsigned int& nbGroups) const { nbGroups = m_nbGroups; return m_groups; };
+	const std::vector<unsigned short>& getFaceTrackedUsers() {return m_faceTrackedUsers;};
 	bool nbFaceTrackedUsersChanged() { return m_nbFaceTrackedUsers != m_nbFaceTrackedUsersPrev; };
+	// annotated face images of the last update (display mode only), to be shown by the display stage
+	const std::vector<std::pair<unsigned int, FramePool::Frame> >& getFaces() { return m_faces; };
+	// users of the last update, in the order of the tracking source
+	const UserSnapshot& getSnapshot() const { return m_snapshot; };
+	// attention after the last update, from any thread: never blocks the update, and every
+	// reader gets a whole frame
+	void getAttention(AttentionState& state) const { m_attention.read(state); };
+	// record the tracking data read during each update (0 to stop)
+	void setRecorder(SessionRecorder* recorder) { m_recorder = recorder; };
+	/**
+	* \brief Replace the screens, from any thread but one thread at a time (the configuration watcher).
+	*	The manager takes ownership, the new screens are used from the next update: the frame loop
+	*	picks them with one atomic exchange and never waits for the caller.
+	*/
+	void setScreenManager(KITV::ScreenManager* screenManager);
+
+	/**
+	* \brief Bound the work per frame in crowds: the gaze, screens and face display of the fullRateUsers
+	*	users with the best head confidence (then the closest) are updated every frame, the other users
+	*	one frame out of decimation. Users with a null confidence never are, they watch no screen.
+	*/
+	void setBudget(unsigned int fullRateUsers, unsigned int decimation = 4) { m_fullRateUsers = fullRateUsers; m_decimation = std::max(1u, decimation); };
+
+	/**
+	* \brief Engagement of the users: score of each screen decayed with the time constant (s) and raised while
+	*	the screen is watched, so that it tends to the share of the last timeConstant seconds spent on it.
+	*	The scores are sent rate times per second (0: never).
+	*/
+	void setEngagement(float rate, float timeConstant = 5.0f) { m_engagementPeriod = rate > 0 ? 1.0f / rate : 0.0f; m_engagementTimeConstant = timeConstant; };
 
-	std::deque<FubiUser*> m_users;
+	// steps of update, public for the benchmarks
+	// headDistance in mm
+	float getHeadRotationConfidence(float headDistance);
+	void updateFaceTrackedUsers();
 
 private:
-	cv::Rect getFaceRect(FubiUser* user);
-	float getHeadRotationConfidence(FubiUser* user);
-	void addInfoToFace(FubiUser* user, cv::Mat& image);
+	void init();
+	// nbUpdated: users at the beginning of m_gazeIndices whose screen watched was updated
+	void publishEvents(unsigned int nbUpdated);
+	void publishAttention();
+	// face tracked users by screen watched, in one pass over the users
+	void updateAttentionGroups();
+	// decay and raise the engagement scores by the time elapsed since the last frame
+	void updateEngagement();
+	UserEvent& addEvent(UserEvent::Type type);
+	// slot of a user, a free or the least recently tracked one is taken for a new user
+	UserSlot& getSlot(unsigned int userID);
+	// face rectangle clamped to the image, empty if outside of it
+	cv::Rect getFaceRect(const cv::Rect& faceRect, const cv::Size& imageSize);
+	// index of the user in the snapshot, name read beforehand: called by the pool threads
+	// image: FacePanel::WIDTH x FacePanel::HEIGHT, the face already in its top rows
+	void addInfoToFace(unsigned int index, const std::string& name, cv::Mat& image);
 	
 
 	bool m_allUsersLookingSameScreen;
@@ -44,20 +143,56 @@ private:
 	cv::Mat m_rgbImg;
 	int m_width, m_height;
 	bool m_display;
-	double lastTime;
+	double lastTime;	// of the last update (s), for the engagement decay
 
 
-	std::vector<unsigned short> m_attentionChanged;
+	UserEvent m_events[MAX_EVENTS];
+	unsigned int m_nbEvents;
 	std::vector<unsigned short> m_faceTrackedUsers;
-	std::map<unsigned short, std::deque<bool>> m_faceTrackedUsersFilter;
+	UserSlot m_slots[Fubi::MaxUsers];
+	// a user is face tracked if the face was found in m_faceTrackedMinFrames of the last m_faceTrackedUsersFilterSize frames
 	unsigned int m_faceTrackedUsersFilterSize;
-	std::map<int, cv::Point3f> m_intersectionCoordinates;
-
-	KITV::ScreenManager* m_screenManager;
-
-	WindowManager m_windowManager;
-
+	unsigned int m_faceTrackedMinFrames;
+	// annotated faces handed to the display, before the frames taken from it
+	FramePool m_facePool;
+	std::vector<std::pair<unsigned int, FramePool::Frame> > m_faces;
+	UserSnapshot m_snapshot;
 
-	std::vector<std::pair<float, float> > m_confidenceByDistance;
+	ITrackingSource& m_source;
+	KITV::ScreenManager* m_screenManager;	// only used by update, never modified
+	// screens published by setScreenManager and not used yet, screens replaced by the last update
+	std::atomic<KITV::ScreenManager*> m_pendingScreens;
+	std::atomic<KITV::ScreenManager*> m_retiredScreens;
+	unsigned int m_fullRateUsers;
+	unsigned int m_decimation;
+	unsigned int m_frameCount;
+	// users updated this frame (index in the snapshot) and their gaze, for the batched screen test
+	unsigned int m_gazeIndices[Fubi::MaxUsers];
+	GazeRay m_gazes[Fubi::MaxUsers];
+	KITV::ScreenHit m_hits[Fubi::MaxUsers];
+	// face crops of the scheduled users, annotated in parallel then merged in m_faces in the same order
+	WorkPool m_pool;
+	std::string m_faceNames[Fubi::MaxUsers];
+	FramePool::Frame m_faceImages[Fubi::MaxUsers];
+	// lines of the user of each slot, drawn once
+	FacePanel m_panels[Fubi::MaxUsers];
+	SessionRecorder* m_recorder;
+	// head rotation confidence of the users of the snapshot, their slot (MaxUsers if not face tracked)
+	float m_headConfidences[Fubi::MaxUsers];
+	unsigned int m_snapshotSlots[Fubi::MaxUsers];
+	float m_engagementTimeConstant;
+	float m_engagementPeriod;
+	double m_lastEngagementTime;
+	bool m_sendEngagement;		// this frame
+	// groups of users by screen: a group is reported once its members stayed the same m_groupStableFrames frames
+	AttentionGroup m_groups[MAX_GROUPS];
+	unsigned int m_nbGroups;
+	bool m_groupsOverflow;		// already reported
+	unsigned int m_groupStableFrames;
+	unsigned int m_changedGroups[MAX_GROUPS];
+	unsigned int m_nbChangedGroups;
+	// state of the last update, built here then published to the readers
+	AttentionState m_attentionFrame;
+	SeqLock<AttentionState> m_attention;
 };
 
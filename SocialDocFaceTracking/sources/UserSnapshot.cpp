@@ -0,0 +1,45 @@
+#include "UserSnapshot.h"
+
+
+void UserSnapshot::capture(ITrackingSource& source)
+{
+	time = source.getCurrentTime();
+	unsigned int nbIDs = source.fillClosestUserIDs(ids, Fubi::MaxUsers);
+
+	count = 0;
+	for (unsigned int i = 0; i < nbIDs; i++)
+	{
+		TrackedUser* user = source.getUser(ids[i]);
+		if (!user)
+			continue;
+		unsigned int index = count++;
+		ids[index] = ids[i];
+		users[index] = user;
+		isFaceTracked[index] = user->m_isFaceTracked;
+		faceRects[index] = user->m_faceRectCv;
+		torsoDistances[index] = user->m_torsoPosition.z;
+		if (user->m_isFaceTracked)
+		{
+			headCenters[index] = source.getUserHeadCenter(ids[index]);
+			headRotations[index] = source.getUserHeadRotation(ids[index]);
+			headDistances[index] = headCenters[index].length();
+		}
+		else
+		{
+			headCenters[index] = Fubi::Vec3f(0, 0, 0);
+			headRotations[index] = Fubi::Vec3f(0, 0, 0);
+			headDistances[index] = 0;
+		}
+	}
+}
+
+
+int UserSnapshot::find(unsigned int userID) const
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (ids[i] == userID)
+			return (int)i;
+	}
+	return -1;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "TrackingSource.h"
+
+/**
+* \brief Tracking data of all the users for one frame, read once from the tracking source.
+*	Structure of arrays in the order of the source (closest user first), so that the
+*	attention analysis, the OSC messages and the display all read the same values.
+*	The head is only read for the face tracked users.
+*/
+struct UserSnapshot
+{
+	unsigned int count;
+	double time;
+
+	unsigned int ids[Fubi::MaxUsers];
+	TrackedUser* users[Fubi::MaxUsers];			// interest state, owned by the source
+	bool isFaceTracked[Fubi::MaxUsers];
+	cv::Rect faceRects[Fubi::MaxUsers];
+	Fubi::Vec3f headCenters[Fubi::MaxUsers];	// mm
+	Fubi::Vec3f headRotations[Fubi::MaxUsers];	// degrees (pitch, yaw, roll)
+	float headDistances[Fubi::MaxUsers];		// from the sensor (mm)
+	float torsoDistances[Fubi::MaxUsers];		// z of the torso (mm)
+
+	UserSnapshot() : count(0), time(0) {};
+
+	// read the current frame of the source
+	void capture(ITrackingSource& source);
+	// index of a user in the snapshot, -1 if absent
+	int find(unsigned int userID) const;
+};
@@ -1,9 +1,13 @@
 #include "WindowManager.h"
 
+#include <algorithm>
+#include <iostream>
 
-WindowManager::WindowManager()
+static const char* MOSAIC_WINDOW = "KISD";
+
+
+WindowManager::WindowManager() : m_relayout(false), m_windowCreated(false), m_columns(1)
 {
-	m_userDisplayZones = std::vector<int>(4, -1);
 }
 
 
@@ -11,140 +15,140 @@ WindowManager::~WindowManager()
 {
 }
 
-void WindowManager::show(const cv::Mat & frame, WindowType type, int userID)
-{
-	Window wind(type, userID);
-	
-	// find the window in m_window
-	int index = getWindowIndex(wind);
 
-	if (index == -1) // the window does not exist
+void WindowManager::init(int width, int height)
+{
+	m_mosaic = cv::Mat(height, 2 * width, CV_8UC3, cv::Scalar(0, 0, 0));
+	m_main = m_mosaic(cv::Rect(0, 0, width, height));
+	m_grid = m_mosaic(cv::Rect(width, 0, width, height));
+	for (unsigned int i = 0; i < Fubi::MaxUsers; i++)
 	{
-		// get size
-		wind.w = frame.size().width;
-		wind.h = frame.size().height;
-		
-		// set title and initial values for x and y
-		std::ostringstream oss;
-		int x, y;
-		switch (type)
-		{
-		case FACE:
-			x = 0;
-			y = 0;
-			oss << "User " << userID;
-			break;
-		case AUS:
-			x = 260;
-			y = 0;
-			oss << "AUs: User " << userID;
-			break;
-		case EMOTIONS:
-			x = 260;
-			y = 180;
-			oss << "expressions : User " << userID;
-			break;
-		}
-		// add title
-		wind.title = oss.str();
-
-		// calculate x and y
-		int dispIndex = -1;
-		for (int i = 0; i < 4; i++)
-		{
-			if (m_userDisplayZones[i] == userID)
-				dispIndex = i;
-		}
-		if (dispIndex == -1)
-		{
-			dispIndex = nextAvailableZone();
-			m_userDisplayZones[dispIndex] = userID;
-		}
-			
-
-		switch (dispIndex)
-		{
-		case 0:
-			break;
-		case 1:
-			y += 420;
-			break;
-		case 2:
-			x += 680;
-			break;
-		case 3:
-			y += 420;
-			x += 680;
-			break;
-		default:
-			break;
-		}
+		if (m_tiles[i].face.empty())
+			m_tiles[i].face = cv::Mat(TILE_HEIGHT, TILE_WIDTH, CV_8UC3, cv::Scalar(0, 0, 0));
+	}
+	m_relayout = true;
+}
 
-		// move the window to the correct place
-		wind.x = x;
-		wind.y = y;
-		cv::namedWindow(wind.title);
-		std::cout << "moving window " << wind.title << " to " << wind.x << ", " << wind.y << std::endl;
-		cv::moveWindow(wind.title, wind.x, wind.y);
 
-		// store it in m_windows
-		m_windows.push_back(wind);
-		index = m_windows.size() - 1;
+void WindowManager::setFace(unsigned int userID, const cv::Mat& face)
+{
+	if (face.empty())
+		return;
+	Tile* tile = 0;
+	Tile* freeTile = 0;
+	for (unsigned int i = 0; i < Fubi::MaxUsers && !tile; i++)
+	{
+		if (m_tiles[i].userID == userID)
+			tile = &m_tiles[i];
+		else if (!freeTile && m_tiles[i].userID == 0)
+			freeTile = &m_tiles[i];
 	}
-	// display the window
-	cv::imshow(m_windows[index].title, frame);
+	if (!tile)
+	{
+		if (!freeTile)
+			return;
+		tile = freeTile;
+		tile->userID = userID;
+		m_relayout = true;
+	}
+
+	// copied in the buffer of the tile, which keeps its size
+	int width = std::min(face.cols, TILE_WIDTH);
+	tile->faceHeight = std::min(face.rows, TILE_HEIGHT);
+	cv::Mat area = tile->face(cv::Rect(0, 0, width, tile->faceHeight));
+	face(cv::Rect(0, 0, width, tile->faceHeight)).copyTo(area);
+	tile->changed = true;
 }
 
-void WindowManager::clearUnused(std::deque<unsigned int> activeUsers)
+
+void WindowManager::clearUnused(const unsigned int* activeUsers, unsigned int nbUsers)
 {
-	for (unsigned int i = 0; i < m_windows.size(); i++)
+	for (unsigned int i = 0; i < Fubi::MaxUsers; i++)
 	{
-		// if the windows number i in the vector has a userID different
-		// from all in the activeUsers deque, destroy it and remove it from the vector
-		if (std::find(activeUsers.begin(), activeUsers.end(), m_windows[i].userID) == activeUsers.end())
+		if (m_tiles[i].userID != 0 && std::find(activeUsers, activeUsers + nbUsers, m_tiles[i].userID) == activeUsers + nbUsers)
 		{
-			// free the display zone
-			for (int j = 0; j < 4; j++)
-			{
-				if (m_userDisplayZones[j] == m_windows[i].userID)
-					m_userDisplayZones[j] = -1;
-			}
-
-			// destroy the window
-			cv::destroyWindow(m_windows[i].title);
-			m_windows.erase(m_windows.begin() + i);
-			i--; // decrement i to adjust to the new size of m_windows
+			m_tiles[i].userID = 0;
+			m_relayout = true;
 		}
 	}
 }
 
-int WindowManager::getWindowIndex(const Window & window)
+
+void WindowManager::layout(unsigned int nbTiles)
 {
-	int index = -1;
-	for (unsigned int i = 0; i < m_windows.size(); i++)
+	m_columns = 1;
+	m_tileSize = cv::Size(0, 0);
+	double bestScale = 0;
+	for (unsigned int rows = 1; rows <= std::max(nbTiles, 1u); rows++)
 	{
-		if (m_windows[i] == window)
-			index = i;
+		int columns = (int)((std::max(nbTiles, 1u) + rows - 1) / rows);
+		double scale = std::min((double)m_grid.cols / (columns * TILE_WIDTH), (double)m_grid.rows / (rows * TILE_HEIGHT));
+		if (scale > bestScale)
+		{
+			bestScale = scale;
+			m_columns = columns;
+		}
 	}
-	return index;
+	bestScale = std::min(bestScale, 1.0);
+	m_tileSize = cv::Size((int)(TILE_WIDTH * bestScale), (int)(TILE_HEIGHT * bestScale));
+
+	m_grid.setTo(cv::Scalar(0, 0, 0));
+	for (unsigned int i = 0; i < Fubi::MaxUsers; i++)
+		m_tiles[i].changed = m_tiles[i].userID != 0;
+	m_relayout = false;
 }
 
 
-int WindowManager::nextAvailableZone()
+void WindowManager::render()
 {
-	int index = -1;
-	for (int i = 0; i < 4; i++)
+	if (m_mosaic.empty())
+		return;
+
+	if (m_relayout)
+	{
+		unsigned int nbTiles = 0;
+		for (unsigned int i = 0; i < Fubi::MaxUsers; i++)
+		{
+			if (m_tiles[i].userID != 0)
+				nbTiles++;
+		}
+		layout(nbTiles);
+	}
+
+	// the tiles in use, packed in the order of the table
+	unsigned int position = 0;
+	for (unsigned int i = 0; i < Fubi::MaxUsers; i++)
 	{
-		if (m_userDisplayZones[i] == -1)
-			return i;
+		Tile& tile = m_tiles[i];
+		if (tile.userID == 0)
+			continue;
+		if (tile.changed && m_tileSize.width > 0 && m_tileSize.height > 0)
+		{
+			cv::Rect rect((position % m_columns) * m_tileSize.width, (position / m_columns) * m_tileSize.height,
+				m_tileSize.width, m_tileSize.height);
+			// resized in place in the mosaic, the rest of the tile is cleared
+			int height = std::max(1, tile.faceHeight * m_tileSize.height / TILE_HEIGHT);
+			cv::Mat area = m_grid(cv::Rect(rect.x, rect.y, rect.width, height));
+			cv::resize(tile.face(cv::Rect(0, 0, TILE_WIDTH, tile.faceHeight)), area, area.size());
+			if (height < rect.height)
+				m_grid(cv::Rect(rect.x, rect.y + height, rect.width, rect.height - height)).setTo(cv::Scalar(0, 0, 0));
+			tile.changed = false;
+		}
+		position++;
 	}
-	return index;
 }
 
-bool operator==(Window const& a, Window const& b)
+
+void WindowManager::show()
 {
-	if (a.type == b.type && a.userID == b.userID)
-		return true;
-	else
-		return false;
+	render();
+	if (m_mosaic.empty())
+		return;
+	// created on the first show only: rendering for the stream alone never touches HighGUI
+	if (!m_windowCreated)
+	{
+		cv::namedWindow(MOSAIC_WINDOW);
+		m_windowCreated = true;
+	}
+	cv::imshow(MOSAIC_WINDOW, m_mosaic);
 }
@@ -1,40 +1,58 @@
 #pragma once
 #include <opencv2/opencv.hpp>
-
-enum WindowType
-{
-	FACE,
-	AUS,
-	EMOTIONS
-};
-
-struct Window
-{
-	WindowType type;
-	unsigned int userID;
-	std::string title;
-	int x, y;
-	int w, h;
-
-	Window(WindowType _type, int _userID): type(_type), userID(_userID){};
-};
-
-bool operator==(Window const& a, Window const& b);
-
-
+#include <Fubi/FubiUtils.h>
+
+/**
+* \brief Debug display in a single window: the colour image on the left and the faces of the users
+*	in a grid on the right, composited in one mosaic allocated at init and shown with one imshow.
+*	The grid adapts to the number of users, up to MaxUsers tiles, and a tile is only redrawn
+*	when its user got a new face image.
+*/
 class WindowManager
 {
 public:
 	WindowManager();
 	~WindowManager();
-	void show(const cv::Mat & frame, WindowType type, int userID);
-	void clearUnused(std::deque<unsigned int> activeUsers);
+	// size of the colour image, the face grid takes the same size on its right (no window yet)
+	void init(int width, int height);
+	int getWidth() const { return m_main.cols; };
+	int getHeight() const { return m_main.rows; };
+	// area of the mosaic where to copy and annotate the colour image
+	cv::Mat& getMainView() { return m_main; };
+	// face image of a user, kept until the user leaves
+	void setFace(unsigned int userID, const cv::Mat& face);
+	// free the tiles of the users not in activeUsers
+	void clearUnused(const unsigned int* activeUsers, unsigned int nbUsers);
+	// redraw the changed tiles
+	void render();
+	// render and show the mosaic, the window is created by the first call
+	void show();
+	// whole mosaic, as last rendered
+	const cv::Mat& getMosaic() const { return m_mosaic; };
 
 private:
-	int getWindowIndex(const Window & window);
-	int nextAvailableZone();
-
-	std::vector<Window> m_windows;
-	std::vector<int> m_userDisplayZones;
+	// a face as sent by the UserManager: 240x320 and the annotation lines
+	static const int TILE_WIDTH = 240;
+	static const int TILE_HEIGHT = 400;
+
+	struct Tile
+	{
+		unsigned int userID;	// 0 if free
+		cv::Mat face;			// TILE_WIDTH x TILE_HEIGHT, allocated once
+		int faceHeight;			// rows of face used
+		bool changed;
+		Tile() : userID(0), faceHeight(0), changed(false) {};
+	};
+
+	// grid with the largest tiles for the users present, all tiles are redrawn
+	void layout(unsigned int nbTiles);
+
+	cv::Mat m_mosaic;
+	cv::Mat m_main;		// left half of m_mosaic
+	cv::Mat m_grid;		// right half of m_mosaic
+	Tile m_tiles[Fubi::MaxUsers];
+	bool m_relayout;	// a user arrived or left, the tiles move
+	bool m_windowCreated;
+	int m_columns;
+	cv::Size m_tileSize;
 };
-
@@ -0,0 +1,145 @@
+#include "WorkPool.h"
+
+#include <algorithm>
+#include <new>
+#ifdef _MSC_VER
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#endif
+
+
+WorkPool::WorkPool(unsigned int nbThreads) :
+m_generation(0), m_stop(false), m_call(0), m_task(0), m_nbRanges(0), m_pending(0), m_busy(0)
+{
+	if (nbThreads == 0)
+		nbThreads = std::max(1u, std::thread::hardware_concurrency());
+	nbThreads = std::min(nbThreads, MAX_THREADS);
+	for (unsigned int i = 0; i < MAX_THREADS; i++)
+	{
+		m_ranges[i].next = 0;
+		m_ranges[i].end = 0;
+	}
+	// the calling thread is the first participant
+	for (unsigned int i = 1; i < nbThreads; i++)
+		m_workers.push_back(std::thread(&WorkPool::workerLoop, this, i));
+}
+
+
+WorkPool::~WorkPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (unsigned int i = 0; i < m_workers.size(); i++)
+		m_workers[i].join();
+}
+
+
+void* WorkPool::operator new(size_t size)
+{
+	void* p = 0;
+#ifdef _MSC_VER
+	p = _aligned_malloc(size, __alignof(Range));
+#else
+	if (posix_memalign(&p, alignof(Range), size) != 0)
+		p = 0;
+#endif
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+
+void WorkPool::operator delete(void* p)
+{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+
+void WorkPool::run(unsigned int count, TaskCall call, void* task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		// a worker late for the previous call may still be looking for items, and no worker
+		// can start while the lock is held
+		while (m_busy.load(std::memory_order_acquire) > 0)
+			std::this_thread::yield();
+
+		m_call = call;
+		m_task = task;
+		m_nbRanges = std::min(count, getNbThreads());
+		for (unsigned int i = 0; i < m_nbRanges; i++)
+		{
+			m_ranges[i].next.store(count * i / m_nbRanges, std::memory_order_relaxed);
+			m_ranges[i].end = count * (i + 1) / m_nbRanges;
+		}
+		m_pending.store(count, std::memory_order_relaxed);
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	work(0);
+	// the results of the workers are visible once their items are counted
+	while (m_pending.load(std::memory_order_acquire) > 0)
+		std::this_thread::yield();
+
+	// a task failed on any thread: fail on the calling one
+	if (m_error)
+	{
+		std::exception_ptr error;
+		std::swap(error, m_error);
+		std::rethrow_exception(error);
+	}
+}
+
+
+void WorkPool::workerLoop(unsigned int participant)
+{
+	unsigned int generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&]() { return m_stop || m_generation != generation; });
+			if (m_stop)
+				return;
+			generation = m_generation;
+			m_busy.fetch_add(1, std::memory_order_relaxed);
+		}
+		// less items than threads: the extra workers only steal
+		work(participant < m_nbRanges ? participant : m_nbRanges);
+		m_busy.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+
+void WorkPool::work(unsigned int participant)
+{
+	for (unsigned int r = 0; r < m_nbRanges; r++)
+	{
+		Range& range = m_ranges[(participant + r) % m_nbRanges];
+		unsigned int i;
+		while ((i = range.next.fetch_add(1, std::memory_order_relaxed)) < range.end)
+		{
+			try
+			{
+				m_call(m_task, i);
+			}
+			catch (...)
+			{
+				// an exception leaving a worker thread would terminate the application
+				std::lock_guard<std::mutex> lock(m_errorMutex);
+				if (!m_error)
+					m_error = std::current_exception();
+			}
+			m_pending.fetch_sub(1, std::memory_order_acq_rel);
+		}
+	}
+}
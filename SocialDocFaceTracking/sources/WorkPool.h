@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+// one cache line, so that data written by different threads never share one
+#ifdef _MSC_VER
+#define KISD_CACHE_ALIGNED __declspec(align(64))
+#else
+#define KISD_CACHE_ALIGNED alignas(64)
+#endif
+
+/**
+* \brief Small work-stealing pool for the per-user work of a frame.
+*	parallelFor splits the items in one contiguous range per thread, the calling thread takes
+*	the first one. A thread that finishes its range steals the remaining items of the others,
+*	so that a user slower to annotate does not hold the whole frame.
+*	The tasks must only write their own outputs, one call of parallelFor at a time.
+*/
+class WorkPool
+{
+public:
+	static const unsigned int MAX_THREADS = 32;
+
+	// nbThreads including the calling thread, 0: one per core
+	explicit WorkPool(unsigned int nbThreads = 0);
+	~WorkPool();
+	// the pool owns a cache aligned table, so must be its owner allocated on the heap
+	static void* operator new(size_t size);
+	static void operator delete(void* p);
+
+	unsigned int getNbThreads() const { return (unsigned int)m_workers.size() + 1; };
+
+	/**
+	* \brief Call task(i) for every i in [0, count[ and return once they are all done.
+	*	Without worker threads, or for a single item, everything runs on the calling thread.
+	*	The first exception thrown by a task is rethrown here once every item is done.
+	*/
+	template <typename Task>
+	void parallelFor(unsigned int count, Task& task)
+	{
+		if (m_workers.empty() || count < 2)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				task(i);
+			return;
+		}
+		run(count, &WorkPool::call<Task>, &task);
+	}
+
+private:
+	typedef void(*TaskCall)(void* task, unsigned int index);
+
+	template <typename Task>
+	static void call(void* task, unsigned int index) { (*(Task*)task)(index); };
+
+	// items [next, end[ not taken yet from the range of one thread, next may run past end
+	struct KISD_CACHE_ALIGNED Range
+	{
+		std::atomic<unsigned int> next;
+		unsigned int end;
+	};
+
+	void run(unsigned int count, TaskCall call, void* task);
+	void workerLoop(unsigned int participant);
+	// take items of the own range first, then of the others
+	void work(unsigned int participant);
+
+	Range m_ranges[MAX_THREADS];
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	unsigned int m_generation;		// incremented for each parallelFor, under m_mutex
+	bool m_stop;
+
+	TaskCall m_call;
+	void* m_task;
+	unsigned int m_nbRanges;
+	std::atomic<unsigned int> m_pending;	// items not finished
+	std::atomic<unsigned int> m_busy;		// workers inside work()
+	// first exception of the current call, its own lock as run() holds m_mutex while workers finish
+	std::mutex m_errorMutex;
+	std::exception_ptr m_error;
+};
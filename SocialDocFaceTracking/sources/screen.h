@@ -4,19 +4,77 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <fstream>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
 #include "tinyxml2.h"
+#include "GazeRay.h"
+#include "ConfidenceCurve.h"
 
 namespace KITV
 {
+
+// result of a gaze/screen intersection
+struct ScreenHit
+{
+	int id;				// id of the screen watched, 0 if none
+	unsigned int index;	// index of the screen in the configuration
+	float distance;		// from the head to the screen (m)
+	Fubi::Vec3f point;	// intersection in the camera space (m)
+	float x, y;			// position on the screen from its top left corner as seen by the users, in [0, 1]
+	ScreenHit() : id(0), index(0), distance(0), x(0), y(0) {}
+};
 	
 class ScreenManager {
 public:
 
 	ScreenManager(std::string xmlFile) {
-		loadConfigXML(xmlFile);
+		load(xmlFile);
     }
 
-    void printScreens() {
+	ScreenManager() {}
+
+	// add a screen without XML file, same units and conventions as the CamPosition element
+	void addScreen(int id, float width, float height, int resX, int resY,
+		float centerx, float centery, float centerz, float angleX = 0, float angleY = 0, float angleZ = 0) {
+		ScreenNode tempNode;
+		tempNode.id = id;
+		tempNode.width = width;
+		tempNode.height = height;
+		tempNode.resX = resX;
+		tempNode.resY = resY;
+		tempNode.centerx = centerx;
+		tempNode.centery = centery;
+		tempNode.centerz = centerz;
+		tempNode.angleX = angleX;
+		tempNode.angleY = angleY;
+		tempNode.angleZ = angleZ;
+		computePlane(tempNode);
+		m_screenNodes.push_back(tempNode);
+		buildIndex();
+	}
+
+	unsigned int getNbScreens() const { return m_screenNodes.size(); }
+
+	// head rotation confidence by distance, from the ConfidenceCurve element of the room configuration
+	const ConfidenceCurve& getConfidenceCurve() const { return m_confidence; }
+
+	// replace the screens by the ones of an XML file, false if it cannot be read
+	bool load(const std::string& xmlFile) {
+		m_screenNodes.clear();
+		m_confidence.setDefault();
+		bool loaded = loadConfigXML(xmlFile);
+		if (!loaded)
+		{
+			std::cerr << "Cannot read the screens of " << xmlFile << std::endl;
+			m_screenNodes.clear();
+		}
+		buildIndex();
+		return loaded;
+	}
+
+    void printScreens() const {
 		if (m_screenNodes.empty())
 		{
 			std::cout << "No screen loaded" << std::endl;
@@ -31,15 +89,70 @@ public:
 				<< ", " << m_screenNodes[i].resY << std::endl;
     }
 
-	std::pair<int, cv::Point3f> whichScreenBeingWatched(cv::Point3f gaze1, cv::Point3f gaze2)
+	// nearest screen hit by the gaze, hit.id = 0 if none
+	ScreenHit whichScreenBeingWatched(const GazeRay& gaze) const
 	{
-		for (unsigned int i = 0; i < m_screenNodes.size(); i++)
+		ScreenHit hit;
+		nearestHit(gaze, hit);
+		return hit;
+	}
+
+	/**
+	* \brief Test all the gazes of a frame in one call, same result as whichScreenBeingWatched for each gaze
+	* \param hits array of nbGazes hits, filled by the function
+	*/
+	void whichScreensBeingWatched(const GazeRay* gazes, unsigned int nbGazes, ScreenHit* hits) const
+	{
+		for (unsigned int g = 0; g < nbGazes; g++)
 		{
-			std::pair<bool, cv::Point3f> res = isScreenBeingWatched(i, gaze1, gaze2);
-			if (res.first)
-				return std::pair<int, cv::Point3f>(m_screenNodes[i].id, res.second);
+			hits[g] = ScreenHit();
+			nearestHit(gazes[g], hits[g]);
 		}
-		return std::pair<int, cv::Point3f>(0, cv::Point3f());
+	}
+
+	/**
+	* \brief Ray/plane intersection followed by a bounds check in the plane of the screen
+	* \return true and fill hit if the screen is watched, hit is left untouched otherwise
+	*/
+	bool intersect(unsigned int screenIndex, const GazeRay& gaze, ScreenHit& hit) const
+	{
+		const ScreenNode& screen = m_screenNodes[screenIndex];
+		float denom = screen.normal.dot(gaze.direction);
+		if (std::fabs(denom) < 1e-6f)
+			return false;	// looking along the screen
+		float t = (screen.offset - screen.normal.dot(gaze.origin)) / denom;
+		if (t <= 0)
+			return false;	// screen behind the user
+
+		Fubi::Vec3f point = gaze.origin + gaze.direction * t;
+		Fubi::Vec3f local = point - screen.center;
+		float x = local.dot(screen.axisX);
+		float y = local.dot(screen.axisY);
+		if (std::fabs(x) >= screen.width / 2 || std::fabs(y) >= screen.height / 2)
+			return false;
+
+		hit.id = screen.id;
+		hit.index = screenIndex;
+		hit.distance = t;
+		hit.point = point;
+		// the users face the camera: their left is the +x side
+		hit.x = 0.5f - x / screen.width;
+		hit.y = 0.5f - y / screen.height;
+		return true;
+	}
+
+	/**
+	* \brief Pixel of a screen at a point of the camera space (m), e.g. the point of a ScreenHit
+	* \return pixel from the top left corner of the screen as seen by the users, z = 0
+	*/
+	cv::Point3f pixIntersection(unsigned int screenIndex, cv::Point3f p) const {
+		const ScreenNode& screen = m_screenNodes[screenIndex];
+		Fubi::Vec3f local = Fubi::Vec3f(p.x, p.y, p.z) - screen.center;
+		cv::Point3f r;
+		r.z = 0;
+		r.x = (0.5f - local.dot(screen.axisX) / screen.width) * screen.resX;
+		r.y = (0.5f - local.dot(screen.axisY) / screen.height) * screen.resY;
+		return r;
 	}
 
 private:
@@ -53,45 +166,93 @@ private:
 		float width;
 		float height;
 		float extended_limit_factor;
-		bool isWatched;
 		std::string output;
 		int resX;
 		int resY;
-		float interpixX;
-		float interpixY;
 		float angleX;
 		float angleY;
 		float angleZ;
+
+		// plane of the screen in the camera space, computed once when the screen is loaded:
+		// points p of the plane verify normal.dot(p) == offset, axisX and axisY span the screen from its center
+		Fubi::Vec3f center;
+		Fubi::Vec3f normal;
+		float offset;
+		Fubi::Vec3f axisX;
+		Fubi::Vec3f axisY;
 	};
 
 	std::vector<ScreenNode> m_screenNodes;
+	ConfidenceCurve m_confidence;
+
+	// bounding volume hierarchy over the screen rectangles, nodes stored depth first:
+	// the left child of an inner node follows it, its right child is at index right
+	struct BVHNode
+	{
+		Fubi::Vec3f min;
+		Fubi::Vec3f max;
+		unsigned int first;		// leaf: first screen in m_bvhScreens
+		unsigned int count;		// leaf: number of screens, 0 for an inner node
+		unsigned int right;		// inner node: index of the right child
+		unsigned int axis;		// inner node: axis of the split
+	};
+
+	// deep enough for any balanced tree
+	static const unsigned int BVH_MAX_DEPTH = 64;
+	static const unsigned int BVH_LEAF_SIZE = 2;
+
+	std::vector<BVHNode> m_bvhNodes;
+	std::vector<unsigned int> m_bvhScreens;	// screen indices, grouped by leaf
+
+	// text of a child element, 0 if it is missing
+	static const char* childText(tinyxml2::XMLElement* element, const char* name) {
+		tinyxml2::XMLElement* child = element->FirstChildElement(name);
+		return child ? child->GetText() : 0;
+	}
 
 	bool loadConfigXML(std::string s) {
 
 		tinyxml2::XMLDocument doc;
 		int i = doc.LoadFile(s.c_str());
-		if (i != 0)
+		if (i != 0 || !doc.FirstChildElement("RoomConfig"))
 			return false;
 		else {
+			// optional, the default curve is kept without it
+			tinyxml2::XMLElement* curve = doc.FirstChildElement("RoomConfig")->FirstChildElement("ConfidenceCurve");
+			if (curve != NULL && !m_confidence.loadXML(curve))
+				return false;
+
 			tinyxml2::XMLElement* screen = doc.FirstChildElement("RoomConfig")->FirstChildElement("Screen");
 			while (screen != NULL) {
-				ScreenNode tempNode;
-				tempNode.id = (int)(atoi(screen->FirstChildElement("id")->GetText()));
-				tempNode.width = (float)atof(screen->FirstChildElement("width")->GetText());
-				tempNode.height = (float)atof(screen->FirstChildElement("height")->GetText());
-				tempNode.resX = (int)atoi(screen->FirstChildElement("resolutionX")->GetText());
-				tempNode.resY = (int)atoi(screen->FirstChildElement("resolutionY")->GetText());
+				const char* id = childText(screen, "id");
+				const char* width = childText(screen, "width");
+				const char* height = childText(screen, "height");
+				const char* resX = childText(screen, "resolutionX");
+				const char* resY = childText(screen, "resolutionY");
+				if (!id || !width || !height || !resX || !resY)
+					return false;
+
+				ScreenNode tempNode = ScreenNode();
+				tempNode.id = (int)(atoi(id));
+				tempNode.width = (float)atof(width);
+				tempNode.height = (float)atof(height);
+				tempNode.resX = (int)atoi(resX);
+				tempNode.resY = (int)atoi(resY);
 
 				tinyxml2::XMLElement* camPos = screen->FirstChildElement("CamPosition");
 				if (camPos != NULL)
 				{
-					tempNode.centerx = (float)atof(camPos->FirstChildElement("centerx")->GetText());
-					tempNode.centery = (float)atof(camPos->FirstChildElement("centery")->GetText());
-					tempNode.centerz = (float)atof(camPos->FirstChildElement("centerz")->GetText());
-					tempNode.angleX = (float)atof(camPos->FirstChildElement("angleX")->GetText());
-					tempNode.angleY = (float)atof(camPos->FirstChildElement("angleY")->GetText());
-					tempNode.angleZ = (float)atof(camPos->FirstChildElement("angleZ")->GetText());
+					const char* values[6] = { childText(camPos, "centerx"), childText(camPos, "centery"), childText(camPos, "centerz"),
+						childText(camPos, "angleX"), childText(camPos, "angleY"), childText(camPos, "angleZ") };
+					float* fields[6] = { &tempNode.centerx, &tempNode.centery, &tempNode.centerz,
+						&tempNode.angleX, &tempNode.angleY, &tempNode.angleZ };
+					for (int v = 0; v < 6; v++)
+					{
+						if (values[v])
+							*fields[v] = (float)atof(values[v]);
+					}
 				}
+				computePlane(tempNode);
 				m_screenNodes.push_back(tempNode);
 				screen = screen->NextSiblingElement("Screen");
 			}
@@ -100,117 +261,148 @@ private:
 		}
 	}
 
-	cv::Point3f pixIntersection(unsigned int screenIndex, cv::Point3f p) {
-		cv::Point3f r;
-		r.z = 0;
-		r.x = (-p.x + m_screenNodes[screenIndex].width / 2) / m_screenNodes[screenIndex].width * m_screenNodes[screenIndex].resX;
-		r.y = (p.y) / m_screenNodes[screenIndex].height * m_screenNodes[screenIndex].resY;
-		return r;
+	// world to screen transform, folded once so that a rotated screen costs the same as an aligned one
+	void computePlane(ScreenNode& screen) {
+		// centery is given from the camera point of view: the screen center is at -centery
+		screen.center = Fubi::Vec3f(screen.centerx, -screen.centery, screen.centerz);
+		// not rotated, the screen faces the users (0, 0, 1); angles in degrees, same rotation order as the heads
+		Fubi::Matrix3f rotation = GazeRay::headRotation(Fubi::Vec3f(screen.angleX, screen.angleY, screen.angleZ));
+		screen.axisX = Fubi::Vec3f(rotation.c[0][0], rotation.c[0][1], rotation.c[0][2]);
+		screen.axisY = Fubi::Vec3f(rotation.c[1][0], rotation.c[1][1], rotation.c[1][2]);
+		screen.normal = Fubi::Vec3f(rotation.c[2][0], rotation.c[2][1], rotation.c[2][2]);
+		screen.offset = screen.normal.dot(screen.center);
+	}
 
+	static float axisValue(const Fubi::Vec3f& v, unsigned int axis) {
+		return (axis == 0) ? v.x : ((axis == 1) ? v.y : v.z);
 	}
 
-	cv::Point3f linePlaneIntersection(unsigned int screenIndex, cv::Point3f p4, cv::Point3f p5)
-	{
-		cv::Point3f p1, p2, p3;
-
-		p1.x = m_screenNodes[screenIndex].centerx - m_screenNodes[screenIndex].width / 2;
-		p1.y = -m_screenNodes[screenIndex].centery - m_screenNodes[screenIndex].height / 2;
-		p1.z = m_screenNodes[screenIndex].centerz;
-
-		p2.x = m_screenNodes[screenIndex].centerx - m_screenNodes[screenIndex].width / 2;
-		p2.y = -m_screenNodes[screenIndex].centery + m_screenNodes[screenIndex].height / 2;
-		p2.z = m_screenNodes[screenIndex].centerz;
-
-		p3.x = m_screenNodes[screenIndex].centerx + m_screenNodes[screenIndex].width / 2;
-		p3.y = -m_screenNodes[screenIndex].centery + m_screenNodes[screenIndex].height / 2;
-		p3.z = m_screenNodes[screenIndex].centerz;
-
-		cv::Mat mat_t_nom = cv::Mat::eye(4, 4, CV_32F);
-		cv::Mat mat_t_denom = cv::Mat::eye(4, 4, CV_32F);
-
-		mat_t_nom.at<float>(0, 0) = 1;
-		mat_t_nom.at<float>(0, 1) = 1;
-		mat_t_nom.at<float>(0, 2) = 1;
-		mat_t_nom.at<float>(0, 3) = 1;
-		mat_t_nom.at<float>(1, 0) = p1.x;
-		mat_t_nom.at<float>(1, 1) = p2.x;
-		mat_t_nom.at<float>(1, 2) = p3.x;
-		mat_t_nom.at<float>(1, 3) = p4.x;
-		mat_t_nom.at<float>(2, 0) = p1.y;
-		mat_t_nom.at<float>(2, 1) = p2.y;
-		mat_t_nom.at<float>(2, 2) = p3.y;
-		mat_t_nom.at<float>(2, 3) = p4.y;
-		mat_t_nom.at<float>(3, 0) = p1.z;
-		mat_t_nom.at<float>(3, 1) = p2.z;
-		mat_t_nom.at<float>(3, 2) = p3.z;
-		mat_t_nom.at<float>(3, 3) = p4.z;
-
-		mat_t_denom.at<float>(0, 0) = 1;
-		mat_t_denom.at<float>(0, 1) = 1;
-		mat_t_denom.at<float>(0, 2) = 1;
-		mat_t_denom.at<float>(0, 3) = 0;
-		mat_t_denom.at<float>(1, 0) = p1.x;
-		mat_t_denom.at<float>(1, 1) = p2.x;
-		mat_t_denom.at<float>(1, 2) = p3.x;
-		mat_t_denom.at<float>(1, 3) = p5.x - p4.x;
-		mat_t_denom.at<float>(2, 0) = p1.y;
-		mat_t_denom.at<float>(2, 1) = p2.y;
-		mat_t_denom.at<float>(2, 2) = p3.y;
-		mat_t_denom.at<float>(2, 3) = p5.y - p4.y;
-		mat_t_denom.at<float>(3, 0) = p1.z;
-		mat_t_denom.at<float>(3, 1) = p2.z;
-		mat_t_denom.at<float>(3, 2) = p3.z;
-		mat_t_denom.at<float>(3, 3) = p5.z - p4.z;
-
-		float t = -((float)cv::determinant(mat_t_nom) / (float)cv::determinant(mat_t_denom));
-
-		cv::Point3f inter;
-
-		inter.x = p4.x + (p5.x - p4.x) * t;
-		inter.y = p4.y + (p5.y - p4.y) * t;
-		inter.z = p4.z + (p5.z - p4.z) * t;
-
-		return inter;
+	// bounding box of a screen rectangle, slightly inflated so that it is never flat
+	void screenBounds(unsigned int screenIndex, Fubi::Vec3f& min, Fubi::Vec3f& max) const {
+		const ScreenNode& screen = m_screenNodes[screenIndex];
+		Fubi::Vec3f halfX = screen.axisX * (screen.width / 2);
+		Fubi::Vec3f halfY = screen.axisY * (screen.height / 2);
+		Fubi::Vec3f extent(std::fabs(halfX.x) + std::fabs(halfY.x) + 1e-4f,
+			std::fabs(halfX.y) + std::fabs(halfY.y) + 1e-4f,
+			std::fabs(halfX.z) + std::fabs(halfY.z) + 1e-4f);
+		min = screen.center - extent;
+		max = screen.center + extent;
 	}
 
-	std::pair<bool, cv::Point3f> isScreenBeingWatched(unsigned int screenIndex, cv::Point3f gaze1, cv::Point3f gaze2)
-	{
+	// rebuilt whenever the screens change, queries never modify the tree
+	void buildIndex() {
+		m_bvhNodes.clear();
+		m_bvhScreens.resize(m_screenNodes.size());
+		for (unsigned int i = 0; i < m_screenNodes.size(); i++)
+			m_bvhScreens[i] = i;
+		if (!m_screenNodes.empty())
+			buildNode(0, m_screenNodes.size(), 0);
+	}
 
-		cv::Point3f inter = linePlaneIntersection(screenIndex, gaze1, gaze2);
-		//        std::cout<<resX<<" "<<resY<<std::endl;
-		//        std::cout<<"            "<<inter.x<<","<<inter.y<<std::endl;
-		//        std::cout<<"                    delta"<<fabs((inter.x-(centerx - width / 2))/width)<<","<<fabs((inter.y- (-centery - height / 2))/height)<<std::endl;
-		//        
-		//        if (inter.x > centerx - width / 2 && inter.x < centerx + width / 2) {
-		//            if (inter.y>-centery - height / 2 && inter.y<-centery + height / 2) {
-		if (inter.x > m_screenNodes[screenIndex].centerx - m_screenNodes[screenIndex].width / 2 
-			&& inter.x < m_screenNodes[screenIndex].centerx + m_screenNodes[screenIndex].width / 2 
-			&& inter.y>-m_screenNodes[screenIndex].centery - m_screenNodes[screenIndex].height / 2 
-			&& inter.y<-m_screenNodes[screenIndex].centery + m_screenNodes[screenIndex].height / 2)
+	// median split of the screens [first, first + count[ along the longest axis of their centers
+	void buildNode(unsigned int first, unsigned int count, unsigned int depth) {
+		unsigned int nodeIndex = m_bvhNodes.size();
+		m_bvhNodes.push_back(BVHNode());
+
+		BVHNode node;
+		screenBounds(m_bvhScreens[first], node.min, node.max);
+		Fubi::Vec3f centerMin = m_screenNodes[m_bvhScreens[first]].center, centerMax = centerMin;
+		for (unsigned int i = first + 1; i < first + count; i++)
 		{
-			//                std::cout << "LOOKING IN THE TV: " << id << std::endl;
-			m_screenNodes[screenIndex].isWatched = true;
-			m_screenNodes[screenIndex].interpixX = fabs((inter.x - (m_screenNodes[screenIndex].centerx - (float)m_screenNodes[screenIndex].width / 2)) / (float)m_screenNodes[screenIndex].width);
-			m_screenNodes[screenIndex].interpixY = fabs((inter.y - (-m_screenNodes[screenIndex].centery - (float)m_screenNodes[screenIndex].height / 2)) / (float)m_screenNodes[screenIndex].height);
+			Fubi::Vec3f min, max;
+			screenBounds(m_bvhScreens[i], min, max);
+			node.min = Fubi::Vec3f(std::min(node.min.x, min.x), std::min(node.min.y, min.y), std::min(node.min.z, min.z));
+			node.max = Fubi::Vec3f(std::max(node.max.x, max.x), std::max(node.max.y, max.y), std::max(node.max.z, max.z));
+			const Fubi::Vec3f& c = m_screenNodes[m_bvhScreens[i]].center;
+			centerMin = Fubi::Vec3f(std::min(centerMin.x, c.x), std::min(centerMin.y, c.y), std::min(centerMin.z, c.z));
+			centerMax = Fubi::Vec3f(std::max(centerMax.x, c.x), std::max(centerMax.y, c.y), std::max(centerMax.z, c.z));
+		}
+		node.first = first;
+		node.count = count;
+		node.right = 0;
+		node.axis = 0;
 
-			//            std::cout<<interpixX<<";"<<interpixY<<std::endl; 
+		if (count > BVH_LEAF_SIZE && depth + 1 < BVH_MAX_DEPTH)
+		{
+			Fubi::Vec3f size = centerMax - centerMin;
+			node.axis = (size.x >= size.y && size.x >= size.z) ? 0 : ((size.y >= size.z) ? 1 : 2);
+			unsigned int half = count / 2;
+			const std::vector<ScreenNode>& screens = m_screenNodes;
+			unsigned int axis = node.axis;
+			std::nth_element(m_bvhScreens.begin() + first, m_bvhScreens.begin() + first + half, m_bvhScreens.begin() + first + count,
+				[&screens, axis](unsigned int a, unsigned int b) { return axisValue(screens[a].center, axis) < axisValue(screens[b].center, axis); });
+
+			node.count = 0;
+			buildNode(first, half, depth + 1);
+			node.right = m_bvhNodes.size();
+			buildNode(first + half, count - half, depth + 1);
+		}
+		m_bvhNodes[nodeIndex] = node;
+	}
 
-			//std::cout<<(inter.x-(centerx-width/2))*resX/width<<" "<<((-centery + height / 2)-inter.y)*resY/height<<std::endl;
-			//                interpixX=(int) floor( fabs(inter.x -(centerx+width/2)) *resX/width );
-			//interpixX=(int)floor(resY-((-centery + height / 2)-inter.y)*resY/height);
+	// distance along the ray to the entry of the box, or a negative value if it is missed
+	static float rayBoxEntry(const BVHNode& node, const Fubi::Vec3f& origin, const Fubi::Vec3f& invDir) {
+		// a NaN (ray parallel to a slab and starting on its border) is ignored by the min/max below
+		float t1 = (node.min.x - origin.x) * invDir.x, t2 = (node.max.x - origin.x) * invDir.x;
+		float tmin = std::min(t1, t2), tmax = std::max(t1, t2);
+		t1 = (node.min.y - origin.y) * invDir.y; t2 = (node.max.y - origin.y) * invDir.y;
+		tmin = std::max(tmin, std::min(t1, t2)); tmax = std::min(tmax, std::max(t1, t2));
+		t1 = (node.min.z - origin.z) * invDir.z; t2 = (node.max.z - origin.z) * invDir.z;
+		tmin = std::max(tmin, std::min(t1, t2)); tmax = std::min(tmax, std::max(t1, t2));
+		if (tmax < 0 || tmin > tmax)
+			return -1.0f;
+		return std::max(tmin, 0.0f);
+	}
 
-			//                std::cout<<" **************** "<<-inter.x +(centerx+width/2)<<std::endl;
+	// nearest screen in front of the user, hit is left untouched if none
+	bool nearestHit(const GazeRay& gaze, ScreenHit& hit) const {
+		if (m_bvhNodes.empty())
+			return false;
 
+		Fubi::Vec3f invDir(1.0f / gaze.direction.x, 1.0f / gaze.direction.y, 1.0f / gaze.direction.z);
+		float nearest = std::numeric_limits<float>::max();
+		bool found = false;
 
+		unsigned int stack[BVH_MAX_DEPTH];
+		unsigned int top = 0;
+		stack[top++] = 0;
+		while (top > 0)
+		{
+			const BVHNode& node = m_bvhNodes[stack[--top]];
+			float entry = rayBoxEntry(node, gaze.origin, invDir);
+			if (entry < 0 || entry >= nearest)
+				continue;
+
+			if (node.count > 0)
+			{
+				for (unsigned int i = node.first; i < node.first + node.count; i++)
+				{
+					ScreenHit candidate;
+					if (intersect(m_bvhScreens[i], gaze, candidate) && candidate.distance < nearest)
+					{
+						nearest = candidate.distance;
+						hit = candidate;
+						found = true;
+					}
+				}
+			}
+			else
+			{
+				// visit the child on the side the gaze comes from first
+				unsigned int left = (unsigned int)(&node - &m_bvhNodes[0]) + 1;
+				if (axisValue(gaze.direction, node.axis) >= 0)
+				{
+					stack[top++] = node.right;
+					stack[top++] = left;
+				}
+				else
+				{
+					stack[top++] = left;
+					stack[top++] = node.right;
+				}
+			}
 		}
-		else {
-			//            std::cout << "NOT" << std::endl;
-			m_screenNodes[screenIndex].isWatched = false;
-			m_screenNodes[screenIndex].interpixX = 0;
-			m_screenNodes[screenIndex].interpixY = 0;
-		}
-		inter.z = (float)screenIndex+1;
-		return std::pair<bool, cv::Point3f>(m_screenNodes[screenIndex].isWatched, inter);
+		return found;
 	}
 };
 